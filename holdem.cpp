@@ -1,6 +1,35 @@
 // holdem_7462.cpp
-// Compile: g++ holdem_7462.cpp -O2 -std=c++17 -o holdem_7462
+// Compile: g++ holdem_7462.cpp -O2 -std=c++17 -pthread -o holdem_7462
 // Runs: ./holdem_7462
+//       ./holdem_7462 play [hands] [seed]         seeded run (prints its run seed)
+//       ./holdem_7462 replay <seed> <hand>        regenerate one hand of a run
+//       ./holdem_7462 batch [hands] [batchSize]   lockstep batched-policy run
+//       ./holdem_7462 encode [count]              feature encoder throughput
+//       ./holdem_7462 selfplay [hands] [prefix]   self-play records to <prefix>-NNN.bin
+//       ./holdem_7462 br [board cards]            exploitability of random play
+//       ./holdem_7462 resolve [ms] cards [prior=..] [actions] CFR+ re-solve a turn/river spot
+//       ./holdem_7462 strategy [file] [8|16]      write/mmap a quantized strategy table
+//       ./holdem_7462 history                     check integer history keys
+//       ./holdem_7462 hhwrite [file] [hands] [allin%]  write simulated hand histories
+//       ./holdem_7462 hhimport [file]             parse + re-evaluate hand histories
+//       ./holdem_7462 allinev [file]              all-in adjusted EV per player
+//       ./holdem_7462 omaha bench [4|5]           PLO evaluator check + throughput
+//       ./holdem_7462 omaha <hole>... [board=X]   exact PLO4/PLO5 equity
+//       ./holdem_7462 omaha8 ...                  same for Omaha Hi/Lo (8 or better)
+//       ./holdem_7462 shortdeck [hands]           short-deck (6+) table and evaluator check
+//       ./holdem_7462 lowball                     A-5 (8 or better) and 2-7 low examples
+//       ./holdem_7462 stud [hands] [players]      seven-card stud simulation
+//       ./holdem_7462 categories <cards>          exact odds of each final category
+//       ./holdem_7462 draws <hole> <board>        outs by category and draw flags
+//       ./holdem_7462 texture [board]             board texture and nut-hand tables
+//       ./holdem_7462 mcequity <range>... [board=X] [trials] [stratify|antithetic|quasi|se=X|compare]
+//                              [ms=T] [threads=N] [progress]
+//                                             Monte Carlo range equity, optional variance reduction,
+//                                             anytime budgets of time / error across threads
+//       ./holdem_7462 vecenv [tables] [steps]   vectorized RL environment, random actions
+//       ./holdem_7462 makeunmake [deals]        apply/undo hand state over full betting trees
+//       ./holdem_7462 mcts [hands] [threads]    IS-MCTS bot vs calling station / random play
+//       ./holdem_7462 alloccheck [hands]        heap allocations per hand (build with -DHOLDEM_COUNT_ALLOCS)
 //
 // Simulates 3 limit hold'em hands and prints full action logs.
 // Builds a canonical 5-card hand ranking table (1..7462) at startup
@@ -9,6 +38,10 @@
 // This code prioritizes clarity and explanation.
 
 #include <bits/stdc++.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 using namespace std;
 
 /* ------------------------------------------------------------------
@@ -18,6 +51,8 @@ using namespace std;
 const array<int,13> PRIMES   = {2,3,5,7,11,13,17,19,23,29,31,37,41};
 const array<string,13> RANKS = {"2","3","4","5","6","7","8","9","T","J","Q","K","A"};
 const array<string,4> SUITS  = {"Clubs","Diamonds","Hearts","Spades"};
+const char RANK_CHARS[] = "23456789TJQKA";  // short text: rank char + suit letter
+const char SUIT_CHARS[] = "cdhs";           // same order as enum Suit
 
 enum Suit { CLUBS=0, DIAMONDS=1, HEARTS=2, SPADES=3 };
 
@@ -43,12 +78,134 @@ string cardToString(int card) {
     return RANKS[rank-2] + " of " + SUITS[suitIndex];
 }
 
+// Short text such as "Ah", "Td", "7c" (what parseCard reads).
+string cardShortString(int card) {
+    int rank = (card >> 8) & 0xF;             // 2..14
+    int suitBits = (card >> 12) & 0xF;
+    int suitIndex = 0;
+    for(int i=0;i<4;++i) if(suitBits & (1<<i)) suitIndex = i;
+    return string{RANK_CHARS[rank-2], SUIT_CHARS[suitIndex]};
+}
+
+// Parse a rank char and suit letter such as 'A','h' without building a string.
+// Returns the encoded card, or -1 if the pair is not a card.
+int parseCard(char rankChar, char suitChar) {
+    const char* r = strchr(RANK_CHARS, toupper((unsigned char)rankChar));
+    const char* su = strchr(SUIT_CHARS, tolower((unsigned char)suitChar));
+    if(!rankChar || !suitChar || !r || !su) return -1;
+    return encodeCard((int)(r - RANK_CHARS) + 2, (int)(su - SUIT_CHARS));
+}
+
+// Parse short card text such as "Ah", "Td", "7c" (rank char + suit letter).
+// Returns the encoded card, or -1 if the text is not a card.
+int parseCard(const string& txt) {
+    if(txt.size() != 2) return -1;
+    return parseCard(txt[0], txt[1]);
+}
+
 /* ------------------------------------------------------------------
    SECTION B — Deck
+   Per-hand state lives in fixed-capacity inline containers and in a
+   per-thread arena, so a thread that keeps simulating hands stops
+   touching the heap once it has warmed up.
    ------------------------------------------------------------------ */
 
+// Vector with inline storage and a fixed capacity N: no heap allocation,
+// for containers whose maximum size is known (a deck, a hand's kickers).
+template<class T, int N>
+struct InlineVec {
+    T items[N];
+    int count = 0;
+
+    InlineVec() {}
+    InlineVec(initializer_list<T> init) { for(const T& x : init) push_back(x); }
+
+    size_t size() const { return (size_t)count; }
+    bool empty() const { return count == 0; }
+    void clear() { count = 0; }
+    void reserve(size_t) {}
+    void push_back(const T& x) { items[count++] = x; }
+    void pop_back() { --count; }
+    T& back() { return items[count - 1]; }
+    const T& back() const { return items[count - 1]; }
+    T& operator[](size_t i) { return items[i]; }
+    const T& operator[](size_t i) const { return items[i]; }
+    T* data() { return items; }
+    const T* data() const { return items; }
+    T* begin() { return items; }
+    T* end() { return items + count; }
+    const T* begin() const { return items; }
+    const T* end() const { return items + count; }
+
+    template<class It>
+    void insert(T* pos, It first, It last) {
+        int n = (int)distance(first, last), at = (int)(pos - items);
+        for(int i=count-1;i>=at;--i) items[i + n] = items[i];
+        for(int i=0;i<n;++i, ++first) items[at + i] = *first;
+        count += n;
+    }
+    T* erase(T* first, T* last) {
+        T* out = copy(last, end(), first);
+        count = (int)(out - items);
+        return first;
+    }
+};
+
+// Bump allocator for per-hand scratch arrays of trivial types. reset()
+// keeps the blocks, so once a thread has seen its largest hand, later
+// hands are served without the heap. One arena per thread via local().
+struct HandArena {
+    static constexpr size_t BLOCK = 1 << 16;
+    vector<unique_ptr<char[]>> blocks;
+    vector<size_t> sizes;
+    size_t block = 0, offset = 0;
+
+    template<class T>
+    T* alloc(size_t n) {
+        size_t bytes = n * sizeof(T);
+        for(;;) {
+            if(block == blocks.size()) {
+                sizes.push_back(max(BLOCK, bytes + alignof(T)));
+                blocks.emplace_back(new char[sizes.back()]);
+            }
+            size_t at = (offset + alignof(T) - 1) / alignof(T) * alignof(T);
+            if(at + bytes <= sizes[block]) { offset = at + bytes; return (T*)(blocks[block].get() + at); }
+            ++block;
+            offset = 0;
+        }
+    }
+    void reset() { block = 0; offset = 0; }
+
+    static HandArena& local() { thread_local HandArena arena; return arena; }
+};
+
+// Counter-based generator for reproducible runs. The stream used by hand n
+// depends only on (run seed, n), so any hand of a run can be regenerated
+// directly from its number without replaying the hands before it.
+struct HandRng {
+    typedef uint64_t result_type;
+    uint64_t state;
+
+    HandRng(uint64_t runSeed, uint64_t hand) : state(mix(runSeed ^ mix(hand + 0x632BE59BD9B4E019ULL))) {}
+
+    // SplitMix64 finalizer
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t operator()() { state += 0x9E3779B97F4A7C15ULL; return mix(state); }
+    static constexpr uint64_t min() { return 0; }
+    static constexpr uint64_t max() { return ~0ULL; }
+
+    // Uniform value in [0, n). Written out rather than using <random>
+    // distributions so replays match across standard libraries.
+    uint32_t below(uint32_t n) { return (uint32_t)(((*this)() >> 32) * n >> 32); }
+};
+
 struct Deck {
-    vector<int> cards;
+    InlineVec<int, 52> cards;
     Deck() { reset(); }
 
     void reset() {
@@ -62,7 +219,17 @@ struct Deck {
     void shuffle() {
         static random_device rd;
         static mt19937 rng(rd());
-        std::shuffle(cards.begin(), cards.end(), rng);
+        shuffle(rng);
+    }
+
+    // Shuffle with a caller-owned generator (one per thread when running in parallel)
+    void shuffle(mt19937& g) {
+        std::shuffle(cards.begin(), cards.end(), g);
+    }
+
+    // Reproducible shuffle (Fisher-Yates) for seeded runs and replays
+    void shuffle(HandRng& g) {
+        for(int i=(int)cards.size()-1; i>0; --i) swap(cards[i], cards[g.below(i + 1)]);
     }
 
     int deal() {
@@ -87,6 +254,10 @@ struct Deck {
    8 One Pair
    9 High Card
    Smaller category number = better hand.
+   A ruleset type (StandardRules, ShortDeckRules) supplies the deck's
+   lowest rank and the strength order of the categories as compile-time
+   constants; classification, the canonical table and the evaluators
+   are instantiated per ruleset, so no runtime branch picks the variant.
    ------------------------------------------------------------------ */
 
 enum Category {
@@ -101,6 +272,38 @@ enum Category {
     CAT_HIGH_CARD      = 9
 };
 
+// Standard 52-card hold'em.
+struct StandardRules {
+    static constexpr int LOW_RANK = 2;                      // deck holds ranks LOW_RANK..14
+    static constexpr int DECK_SIZE = 4 * (15 - LOW_RANK);
+    static constexpr bool WHEEL = true;                     // ace may play low in a straight
+    static constexpr const char* LABEL = "";
+    // strength position of a category, 1 = best
+    static constexpr int categoryOrder(int cat) { return cat; }
+};
+
+// Short deck (6+): 36 cards, A-6-7-8-9 is the low straight and a flush
+// beats a full house.
+struct ShortDeckRules {
+    static constexpr int LOW_RANK = 6;
+    static constexpr int DECK_SIZE = 4 * (15 - LOW_RANK);
+    static constexpr bool WHEEL = true;
+    static constexpr const char* LABEL = " (short deck)";
+    static constexpr int categoryOrder(int cat) {
+        return cat == CAT_FLUSH ? CAT_FULL_HOUSE : cat == CAT_FULL_HOUSE ? CAT_FLUSH : cat;
+    }
+};
+
+// High-hand order used by deuce-to-seven lowball: the ace is always high,
+// so A-2-3-4-5 is not a straight. The 2-7 low order is this order reversed.
+struct DeuceSevenRules {
+    static constexpr int LOW_RANK = 2;
+    static constexpr int DECK_SIZE = 4 * (15 - LOW_RANK);
+    static constexpr bool WHEEL = false;
+    static constexpr const char* LABEL = " (ace high only)";
+    static constexpr int categoryOrder(int cat) { return cat; }
+};
+
 // Helper: extract rank (2..14) from encoded card
 inline int cardRank(int card) { return (card >> 8) & 0xF; }
 // Helper: return suit index 0..3
@@ -109,13 +312,20 @@ inline int cardSuit(int card) {
     for(int i=0;i<4;++i) if(s & (1<<i)) return i;
     return 0;
 }
+// Helper: dense card index 0..51 (suit*13 + rank-2), same order as Deck::reset
+inline int cardIndex(int card) { return cardSuit(card)*13 + cardRank(card) - 2; }
 
-// Return sorted vector of ranks descending, with Ace as 14.
+// Return ranks sorted descending, with Ace as 14.
 // We will also provide a rank-bit mask for straight detection.
-vector<int> ranksSortedDesc(const array<int,5>& hand) {
-    vector<int> r(5);
-    for(int i=0;i<5;++i) r[i] = cardRank(hand[i]);
-    sort(r.begin(), r.end(), greater<int>());
+InlineVec<int,5> ranksSortedDesc(const array<int,5>& hand) {
+    InlineVec<int,5> r;
+    for(int i=0;i<5;++i) {
+        // insertion sort, descending
+        int v = cardRank(hand[i]), j = i;
+        r.push_back(v);
+        for(; j>0 && r[j-1] < v; --j) r[j] = r[j-1];
+        r[j] = v;
+    }
     return r;
 }
 
@@ -130,13 +340,13 @@ int rankBitmask(const array<int,5>& hand) {
 }
 
 // Detect straight and return highest card of straight (ace-high=14, wheel returns 5)
-// Returns 0 if not straight.
-int detectStraightTop(int rankMask) {
+// Returns 0 if not straight. lowRank is the deck's lowest rank: the ace also
+// plays below it (unless wheel is false), so the short-deck wheel A-6-7-8-9 returns 9.
+int detectStraightTop(int rankMask, int lowRank = 2, bool wheel = true) {
     // rankMask uses bit0 for '2', bit12 for 'A'
     // Straight patterns: any 5 consecutive bits set.
-    // Wheel A-2-3-4-5: bits for A and 2-5 -> mask with top=5
-    // Check top from A(14) down to 5
-    for(int top=14; top>=5; --top) {
+    // Check top from A(14) down to lowRank+4
+    for(int top=14; top>=lowRank+4; --top) {
         int topIndex = top - 2;
         // bits from topIndex down to topIndex-4 must be set
         bool ok = true;
@@ -147,8 +357,9 @@ int detectStraightTop(int rankMask) {
         }
         if(ok) return top;
     }
-    // Wheel special case: A-2-3-4-5 -> bits for A and 2..5
-    // The loop above already finds top=5 if bits present, so it's okay.
+    // Wheel: the ace plus the four lowest ranks (A-2-3-4-5, or A-6-7-8-9)
+    int wheelMask = (1 << 12) | (0xF << (lowRank - 2));
+    if(wheel && (rankMask & wheelMask) == wheelMask) return lowRank + 3;
     return 0;
 }
 
@@ -164,10 +375,11 @@ array<int,15> rankCounts(const array<int,5>& hand) {
 // t1.. are tiebreaker ranks in descending significance (higher -> better)
 struct HandClass {
     int category;              // 1..9 (1 best)
-    vector<int> kickers;       // tiebreaker ranks (e.g., for full house [tripRank, pairRank])
+    InlineVec<int,5> kickers;  // tiebreaker ranks (e.g., for full house [tripRank, pairRank])
 };
 
 // Create canonical HandClass for a 5-card hand
+template<class Rules = StandardRules>
 HandClass classify5(const array<int,5>& hand) {
     HandClass hc;
     // isFlush?
@@ -176,11 +388,11 @@ HandClass classify5(const array<int,5>& hand) {
     for(int i=1;i<5;++i) if(cardSuit(hand[i]) != s0) { flush=false; break; }
 
     int rankMask = rankBitmask(hand);
-    int straightTop = detectStraightTop(rankMask);
+    int straightTop = detectStraightTop(rankMask, Rules::LOW_RANK, Rules::WHEEL);
 
     auto countsArr = rankCounts(hand);
     // Build frequency buckets: map count -> list of ranks
-    vector<int> quads, trips, pairs, singles;
+    InlineVec<int,5> quads, trips, pairs, singles;
     for(int r=14; r>=2; --r) {
         int c = countsArr[r];
         if(c==4) quads.push_back(r);
@@ -227,7 +439,7 @@ HandClass classify5(const array<int,5>& hand) {
     if(!trips.empty()) {
         hc.category = CAT_THREE_KIND;
         int trip = trips[0];
-        vector<int> rest;
+        InlineVec<int,5> rest;
         for(int r=14;r>=2;--r) if(countsArr[r]==1) rest.push_back(r);
         hc.kickers = {trip};
         hc.kickers.insert(hc.kickers.end(), rest.begin(), rest.end()); // 2 kickers
@@ -246,7 +458,7 @@ HandClass classify5(const array<int,5>& hand) {
     if(pairs.size()==1) {
         hc.category = CAT_ONE_PAIR;
         int pair = pairs[0];
-        vector<int> rest;
+        InlineVec<int,5> rest;
         for(int r=14;r>=2;--r) if(countsArr[r]==1) rest.push_back(r);
         hc.kickers = {pair};
         hc.kickers.insert(hc.kickers.end(), rest.begin(), rest.end()); // 3 kickers
@@ -259,19 +471,45 @@ HandClass classify5(const array<int,5>& hand) {
     return hc;
 }
 
-// Convert HandClass to a unique string key for maps/sets
-string handClassKey(const HandClass& hc) {
-    string s = to_string(hc.category) + "|";
-    for(size_t i=0;i<hc.kickers.size();++i){
-        if(i) s.push_back(',');
-        s += to_string(hc.kickers[i]);
+// Unique integer key of a HandClass: category in bits 20+, then the
+// kickers 4 bits each from bit 16 down (the category fixes how many).
+inline uint32_t packedClassKey(const HandClass& hc) {
+    uint32_t key = (uint32_t)hc.category << 20;
+    for(size_t i=0;i<hc.kickers.size();++i) key |= (uint32_t)(hc.kickers[i] & 0xF) << (16 - 4*i);
+    return key;
+}
+
+// Strength key: smaller is better. The rules' category position goes in
+// bits 20+ and each kicker is stored as 15 - rank, so ascending keys run
+// from the best class to the worst (kicker counts are fixed per category).
+template<class Rules = StandardRules>
+inline uint32_t strengthKey(const HandClass& hc) {
+    uint32_t key = (uint32_t)Rules::categoryOrder(hc.category) << 20;
+    for(size_t i=0;i<hc.kickers.size();++i) key |= (uint32_t)(15 - hc.kickers[i]) << (16 - 4*i);
+    return key;
+}
+
+// The HandClass of a strength key (kickers are never rank 15, so an
+// unused slot reads back as 0).
+template<class Rules = StandardRules>
+HandClass classFromStrengthKey(uint32_t key) {
+    HandClass hc;
+    int order = (int)(key >> 20);
+    hc.category = 1;
+    while(Rules::categoryOrder(hc.category) != order) ++hc.category;
+    for(int i=0;i<5;++i) {
+        int nibble = (key >> (16 - 4*i)) & 0xF;
+        if(!nibble) break;
+        hc.kickers.push_back(15 - nibble);
     }
-    return s;
+    return hc;
 }
 
 // Comparator for HandClass: returns true if a is better (should come earlier)
+template<class Rules = StandardRules>
 bool handClassBetter(const HandClass& a, const HandClass& b) {
-    if(a.category != b.category) return a.category < b.category; // smaller category number = better
+    if(a.category != b.category) // smaller strength position = better
+        return Rules::categoryOrder(a.category) < Rules::categoryOrder(b.category);
     // compare kickers lexicographically
     const auto &A = a.kickers, &B = b.kickers;
     size_t n = max(A.size(), B.size());
@@ -286,24 +524,30 @@ bool handClassBetter(const HandClass& a, const HandClass& b) {
 /* ------------------------------------------------------------------
    SECTION D — Build canonical table of all distinct 5-card hand classes
    Output: vector<HandClass> canonicalClasses sorted best->worst,
-           and map key->index (1..N)
+           and packed keys -> index (1..N)
+   Every 5-card hand sets one bit of a bitmap over strength keys; the
+   set bits, read in ascending order, are the classes already sorted
+   best to worst, so the build needs no strings, hashing or sorting.
+   CanonTable is the standard table; ShortDeckCanonTable is the same
+   build over the 36-card deck with the short-deck ordering.
    ------------------------------------------------------------------ */
 
-struct CanonTable {
+template<class Rules>
+struct BasicCanonTable {
     vector<HandClass> classes;               // sorted best->worst
-    unordered_map<string,int> keyToIndex;    // mapping key -> 1..N
+    vector<uint32_t> packedKeys;             // packedClassKey of each class, ascending
+    vector<uint16_t> packedIndex;            // index 1..N of packedKeys[i]
 
     // Build by enumerating all C(52,5) combinations (2,598,960)
     void build() {
-        cout << "Building canonical 5-card hand table (this may take a few seconds)...\n";
+        cout << "Building canonical 5-card hand table" << Rules::LABEL << " (this may take a few seconds)...\n";
         // Generate deck (we need numeric cards to iterate combos)
-        vector<int> deck; deck.reserve(52);
-        for(int s=0;s<4;++s) for(int r=2;r<=14;++r) deck.push_back(encodeCard(r,s));
-        const int N = deck.size(); // 52
+        int deck[52];
+        int N = 0;                               // 52 (36 short deck)
+        for(int s=0;s<4;++s) for(int r=Rules::LOW_RANK;r<=14;++r) deck[N++] = encodeCard(r,s);
 
-        // Use unordered_set<string> to gather unique keys
-        unordered_set<string> uniqueKeys;
-        uniqueKeys.reserve(8000);
+        // one bit per possible strength key (categories 1..9 -> keys below 10 << 20)
+        vector<uint64_t> seen(((size_t)10 << 20) / 64, 0);
 
         array<int,5> hand;
         // iterate combinations i<j<k<l<m
@@ -317,63 +561,50 @@ struct CanonTable {
                         hand[3] = deck[l];
                         for(int m=l+1;m<N;++m){
                             hand[4] = deck[m];
-                            HandClass hc = classify5(hand);
-                            string key = handClassKey(hc);
-                            uniqueKeys.insert(key);
+                            uint32_t key = strengthKey<Rules>(classify5<Rules>(hand));
+                            seen[key >> 6] |= 1ULL << (key & 63);
                         }
                     }
                 }
             }
         }
 
-        // Now move keys into vector<HandClass>
+        // Set bits in ascending order are the classes best->worst
         classes.clear();
-        classes.reserve(uniqueKeys.size());
-        for(const auto &k : uniqueKeys) {
-            // parse back into HandClass
-            // key format: category|t1,t2,...
-            HandClass hc;
-            auto pos = k.find('|');
-            hc.category = stoi(k.substr(0,pos));
-            string rest = k.substr(pos+1);
-            hc.kickers.clear();
-            if(!rest.empty()) {
-                stringstream ss(rest);
-                string tok;
-                while(getline(ss, tok, ',')) hc.kickers.push_back(stoi(tok));
-            }
-            classes.push_back(hc);
-        }
-
-        // Sort by strength best->worst using comparator
-        sort(classes.begin(), classes.end(), [](const HandClass& a, const HandClass& b){
-            return handClassBetter(a,b);
-        });
+        for(size_t w=0; w<seen.size(); ++w)
+            for(uint64_t bits = seen[w]; bits; bits &= bits - 1)
+                classes.push_back(classFromStrengthKey<Rules>((uint32_t)(w*64 + __builtin_ctzll(bits))));
 
-        // Assign indices starting at 1
-        keyToIndex.clear();
-        for(size_t idx=0; idx<classes.size(); ++idx) {
-            string key = handClassKey(classes[idx]);
-            keyToIndex[key] = (int)idx + 1;
-        }
+        // Indices start at 1; lookups search the packed keys
+        vector<pair<uint32_t,uint16_t>> packed;
+        packed.reserve(classes.size());
+        for(size_t idx=0; idx<classes.size(); ++idx) packed.push_back({packedClassKey(classes[idx]), (uint16_t)(idx + 1)});
+        sort(packed.begin(), packed.end());
+        packedKeys.clear();
+        packedIndex.clear();
+        for(auto& pk : packed) { packedKeys.push_back(pk.first); packedIndex.push_back(pk.second); }
         cout << "Canonical table built. Distinct classes: " << classes.size() << "\n";
     }
 
-    // Lookup index for a HandClass
+    // Binary search on the packed keys, so lookups never allocate.
     int lookup(const HandClass& hc) const {
-        string key = handClassKey(hc);
-        auto it = keyToIndex.find(key);
-        if(it == keyToIndex.end()) return -1;
-        return it->second;
+        uint32_t key = packedClassKey(hc);
+        auto it = lower_bound(packedKeys.begin(), packedKeys.end(), key);
+        if(it == packedKeys.end() || *it != key) return -1;
+        return packedIndex[it - packedKeys.begin()];
     }
 };
 
+typedef BasicCanonTable<StandardRules> CanonTable;
+typedef BasicCanonTable<ShortDeckRules> ShortDeckCanonTable;
+
 /* ------------------------------------------------------------------
    SECTION E — Evaluate best 5-card class out of 7 cards, return index 1..N
    ------------------------------------------------------------------ */
 
-// Evaluate best five-card HandClass for a 7-card vector and return the canonical index
-int evaluate7_bestIndex(const vector<int>& cards7, const CanonTable& table) {
+// Evaluate best five-card HandClass for 7 cards and return the canonical index
+template<class Rules>
+int evaluate7_bestIndex(const int* cards7, const BasicCanonTable<Rules>& table) {
     array<int,5> combo;
     HandClass bestHC;
     bool haveBest = false;
@@ -385,8 +616,8 @@ int evaluate7_bestIndex(const vector<int>& cards7, const CanonTable& table) {
     for(int d=c+1;d<7;d++)
     for(int e=d+1;e<7;e++){
         combo = {cards7[a],cards7[b],cards7[c],cards7[d],cards7[e]};
-        HandClass hc = classify5(combo);
-        if(!haveBest || handClassBetter(hc, bestHC)) {
+        HandClass hc = classify5<Rules>(combo);
+        if(!haveBest || handClassBetter<Rules>(hc, bestHC)) {
             bestHC = hc;
             haveBest = true;
         }
@@ -395,6 +626,179 @@ int evaluate7_bestIndex(const vector<int>& cards7, const CanonTable& table) {
     return idx; // 1..7462
 }
 
+template<class Rules>
+int evaluate7_bestIndex(const vector<int>& cards7, const BasicCanonTable<Rules>& table) {
+    return evaluate7_bestIndex(cards7.data(), table);
+}
+
+/* Fast path: Cactus Kev style lookup tables derived from the canonical
+   table, so a 5-card hand costs a couple of array reads instead of a
+   classify5 call plus a string lookup. Indices are identical to
+   CanonTable::lookup (1 = royal flush, 7462 = worst high card), or of
+   the ruleset's own table for other variants.
+   - flushes[rankBits]  all five cards share a suit
+   - unique5[rankBits]  five distinct ranks, no flush (0 = not applicable)
+   - primeIndex         product of rank primes for hands with a paired rank */
+template<class Rules>
+struct BasicFastEvaluator {
+    vector<uint16_t> flushes;
+    vector<uint16_t> unique5;
+    vector<pair<int,int>> primeIndex;   // (prime product, index), sorted by product
+    vector<uint8_t> categoryOf;         // index -> Category
+
+    void build(const BasicCanonTable<Rules>& table) {
+        flushes.assign(8192, 0);
+        unique5.assign(8192, 0);
+        primeIndex.clear();
+        // every multiset of 5 ranks with at most 4 of a rank
+        array<int,5> r;
+        for(r[0]=Rules::LOW_RANK;r[0]<=14;++r[0]) for(r[1]=r[0];r[1]<=14;++r[1])
+        for(r[2]=r[1];r[2]<=14;++r[2]) for(r[3]=r[2];r[3]<=14;++r[3])
+        for(r[4]=r[3];r[4]<=14;++r[4]) {
+            if(r[0]==r[4]) continue; // five of a kind
+            // suit k%4 for the k-th card: equal ranks get distinct suits, never a flush
+            array<int,5> hand;
+            int bits = 0, prod = 1;
+            for(int k=0;k<5;++k) {
+                hand[k] = encodeCard(r[k], k % 4);
+                bits |= 1 << (r[k]-2);
+                prod *= PRIMES[r[k]-2];
+            }
+            int idx = table.lookup(classify5<Rules>(hand));
+            if(__builtin_popcount(bits) == 5) {
+                unique5[bits] = (uint16_t)idx;
+                for(int k=0;k<5;++k) hand[k] = encodeCard(r[k], 0);
+                flushes[bits] = (uint16_t)table.lookup(classify5<Rules>(hand));
+            } else {
+                primeIndex.push_back({prod, idx});
+            }
+        }
+        sort(primeIndex.begin(), primeIndex.end());
+        categoryOf.assign(table.classes.size() + 1, 0);
+        for(size_t i=0;i<table.classes.size();++i) categoryOf[i+1] = (uint8_t)table.classes[i].category;
+    }
+
+    int eval5(int c0, int c1, int c2, int c3, int c4) const {
+        int q = (c0 | c1 | c2 | c3 | c4) >> 16;
+        if(c0 & c1 & c2 & c3 & c4 & 0xF000) return flushes[q];
+        if(unique5[q]) return unique5[q];
+        int prod = (c0 & 0xFF) * (c1 & 0xFF) * (c2 & 0xFF) * (c3 & 0xFF) * (c4 & 0xFF);
+        auto it = lower_bound(primeIndex.begin(), primeIndex.end(), make_pair(prod, 0));
+        return it->second;
+    }
+
+    // Best (lowest) index over the 21 five-card subsets of 7 cards
+    int eval7(const int* c) const {
+        int best = INT_MAX;
+        for(int a=0;a<7;a++) for(int b=a+1;b<7;b++) for(int x=b+1;x<7;x++)
+        for(int d=x+1;d<7;d++) for(int e=d+1;e<7;e++)
+            best = min(best, eval5(c[a], c[b], c[x], c[d], c[e]));
+        return best;
+    }
+};
+
+typedef BasicFastEvaluator<StandardRules> FastEvaluator;
+typedef BasicFastEvaluator<ShortDeckRules> ShortDeckEvaluator;
+
+/* Lowball evaluators, table-driven like FastEvaluator (lower value = better low).
+   - Ace-to-five, eight or better (Omaha Hi/Lo, stud Hi/Lo): straights and
+     flushes do not count, the ace is low and a low needs five distinct
+     ranks of eight or lower. Only the set of such ranks matters, so
+     everything is indexed by an 8-bit low mask (bit 0 = A ... bit 7 = 8):
+     a5[mask] is the best low among those ranks (1 = A-2-3-4-5 ... 56 =
+     8-7-6-5-4, 0 = no low), and omahaA5[board mask][hole mask] applies the
+     two-hole/three-board rule once for every pair of masks.
+   - Deuce-to-seven: the ace is high and straights, flushes and pairs all
+     count against the hand, i.e. the high-hand order without the wheel,
+     reversed. It is read from a FastEvaluator over DeuceSevenRules. */
+inline int lowBit(int card) {
+    int r = cardRank(card);
+    return r == 14 ? 1 : (r <= 8 ? 1 << (r - 1) : 0);
+}
+
+struct LowEvaluator {
+    uint8_t a5[256];
+    uint8_t omahaA5[256][256];
+    BasicFastEvaluator<DeuceSevenRules> aceHigh;
+    int aceHighClasses;
+
+    void build() {
+        // the 56 five-rank lows in ascending mask order are already best -> worst:
+        // comparing masks compares the highest card first
+        int value[256] = {0}, n = 0;
+        for(int m=0;m<256;++m) if(__builtin_popcount(m) == 5) value[m] = ++n;
+        for(int m=0;m<256;++m) {
+            int best = m;
+            while(__builtin_popcount(best) > 5) best &= ~(1 << (31 - __builtin_clz(best)));  // drop the highest rank
+            a5[m] = (uint8_t)(__builtin_popcount(best) == 5 ? value[best] : 0);
+        }
+        for(int board=0; board<256; ++board) for(int hole=0; hole<256; ++hole) {
+            int best = 0;
+            for(int x=hole; x; x&=x-1) for(int y=x&(x-1); y; y&=y-1) {
+                int pair = (x & -x) | (y & -y);
+                int rest = board & ~pair;
+                if(__builtin_popcount(rest) < 3) continue;
+                while(__builtin_popcount(rest) > 3) rest &= ~(1 << (31 - __builtin_clz(rest)));
+                int v = a5[pair | rest];
+                if(v && (!best || v < best)) best = v;
+            }
+            omahaA5[board][hole] = (uint8_t)best;
+        }
+        BasicCanonTable<DeuceSevenRules> table;
+        table.build();
+        aceHigh.build(table);
+        aceHighClasses = (int)table.classes.size();
+    }
+
+    // Best eight-or-better low from any number of cards, 0 = none.
+    int aceToFive(const int* c, int n) const {
+        int mask = 0;
+        for(int i=0;i<n;++i) mask |= lowBit(c[i]);
+        return a5[mask];
+    }
+
+    // Deuce-to-seven value of a 5-card hand, 1 = 7-5-4-3-2 unsuited.
+    int deuceToSeven5(int c0, int c1, int c2, int c3, int c4) const {
+        return aceHighClasses + 1 - aceHigh.eval5(c0, c1, c2, c3, c4);
+    }
+
+    // Best deuce-to-seven low over the 5-card subsets of n (5..7) cards.
+    int deuceToSeven(const int* c, int n) const {
+        int worstHigh = 0;
+        for(int a=0;a<n;a++) for(int b=a+1;b<n;b++) for(int x=b+1;x<n;x++)
+        for(int d=x+1;d<n;d++) for(int e=d+1;e<n;e++)
+            worstHigh = max(worstHigh, aceHigh.eval5(c[a], c[b], c[x], c[d], c[e]));
+        return aceHighClasses + 1 - worstHigh;
+    }
+};
+
+// Mode "lowball": spot checks of both low orders.
+int runLowball() {
+    LowEvaluator low;
+    low.build();
+    auto cards = [](const char* text, int* c) {
+        int n = 0;
+        for(const char* p=text; p[0] && p[1]; p += (p[2] ? 3 : 2)) c[n++] = parseCard(p[0], p[1]);
+        return n;
+    };
+    const char* a5Hands[] = {"Ah 2c 3d 4s 5h", "Ac 2c 3c 4c 5c", "6h 4c 3d 2s Ah", "8h 7c 6d 5s 4h",
+                             "9h 4c 3d 2s Ah", "Ah 2c 3d 4s 4h", "Kh Qd 2c 3d 4s 5h Ac"};
+    for(const char* h : a5Hands) {
+        int c[7], n = cards(h, c);
+        int v = low.aceToFive(c, n);
+        cout << "  A-5 eight or better  " << left << setw(22) << h << right;
+        if(v) cout << v << " of 56\n"; else cout << "no low\n";
+    }
+    const char* d27Hands[] = {"7h 5c 4d 3s 2h", "7h 6c 4d 3s 2h", "8h 5c 4d 3s 2h", "Ah 5c 4d 3s 2h",
+                              "6h 5c 4d 3s 2h", "7h 5h 4h 3h 2h", "2h 2c 7d 5s 3h", "Kh Qd 7c 5d 4s 3h 2c"};
+    for(const char* h : d27Hands) {
+        int c[7], n = cards(h, c);
+        cout << "  2-7 lowball          " << left << setw(22) << h << right
+             << low.deuceToSeven(c, n) << " of " << low.aceHighClasses << "\n";
+    }
+    return 0;
+}
+
 // For human readable category name from HandClass category
 string categoryName(int cat) {
     switch(cat) {
@@ -411,22 +815,80 @@ string categoryName(int cat) {
     }
 }
 
+// Mode "shortdeck": build the short-deck table next to the standard one,
+// check its fast evaluator against evaluate7_bestIndex on random deals
+// and print how often each category is the best 7-card hand.
+int runShortDeck(int numHands) {
+    ShortDeckCanonTable table;
+    table.build();
+    ShortDeckEvaluator eval;
+    eval.build(table);
+
+    vector<int> deck;
+    for(int s=0;s<4;++s) for(int r=ShortDeckRules::LOW_RANK;r<=14;++r) deck.push_back(encodeCard(r, s));
+    mt19937 g(2024);
+    long long mismatches = 0;
+    vector<long long> perCategory(10, 0);
+    vector<int> cards(7);
+    for(int n=0;n<numHands;++n) {
+        for(int k=0;k<7;++k) swap(deck[k], deck[k + g() % (deck.size() - k)]);
+        copy(deck.begin(), deck.begin() + 7, cards.begin());
+        int idx = eval.eval7(cards.data());
+        if(idx != evaluate7_bestIndex(cards, table)) ++mismatches;
+        ++perCategory[eval.categoryOf[idx]];
+    }
+    cout << "Hands: " << numHands << "  fast vs reference mismatches: " << mismatches << "\n";
+    for(int strength=1; strength<=9; ++strength)
+        for(int cat=1; cat<=9; ++cat) if(ShortDeckRules::categoryOrder(cat) == strength)
+            cout << "  " << left << setw(16) << categoryName(cat) << right << fixed << setprecision(3)
+                 << setw(8) << 100.0 * perCategory[cat] / numHands << "%\n";
+    cout << defaultfloat;
+
+    auto show = [&](const char* text) {
+        int c[5];
+        for(int k=0;k<5;++k) c[k] = parseCard(text[3*k], text[3*k+1]);
+        int idx = eval.eval5(c[0], c[1], c[2], c[3], c[4]);
+        cout << "  " << text << " -> " << categoryName(eval.categoryOf[idx]) << " (index " << idx << ")\n";
+    };
+    show("Ah 6c 7d 8s 9h");
+    show("Ah Kh 9h 7h 6h");
+    show("Ac As Ad Kc Ks");
+    return mismatches ? 1 : 0;
+}
+
 /* ------------------------------------------------------------------
    SECTION F — Simple legal Limit betting logic per street (2 players, no fold)
    - This prints every action and enforces that after a bet, only call/raise allowed
    - Raises per street limited to MAX_RAISES
+   - The rules live in streetStart/legalActions/streetApply so that callers
+     which cannot block on a decision (batched runners) can drive a street
+     one action at a time; playStreetLog is the printing driver on top.
+   - HistoryKey packs a whole hand's betting into one integer.
    ------------------------------------------------------------------ */
 
 static random_device rd;
 static mt19937 rng(rd());
 
 enum Action { A_CHECK, A_BET, A_CALL, A_RAISE, A_FOLD };
+const int NUM_ACTIONS = 5;
+const int MAX_RAISES = 4;
+// Longest possible hand: 5 preflop actions + 6 per postflop street.
+const int MAX_HAND_ACTIONS = 24;
 
 Action pickRandom(const vector<Action>& allowed) {
     uniform_int_distribution<int> dist(0, (int)allowed.size()-1);
     return allowed[dist(rng)];
 }
 
+// Same choice driven by the hand's own generator, so seeded runs replay exactly.
+Action pickRandom(const Action* allowed, int n, HandRng& g) {
+    return allowed[g.below((uint32_t)n)];
+}
+
+Action pickRandom(const vector<Action>& allowed, HandRng& g) {
+    return pickRandom(allowed.data(), (int)allowed.size(), g);
+}
+
 string actionStr(Action a) {
     switch(a) {
         case A_CHECK: return "check";
@@ -442,278 +904,5611 @@ struct gameState {
     int pot;
     int firstPlayerChips;
     int secondPlayerChips;
-    std::string lastStreetAction;
+    Action lastStreetAction;
     int lastActingPlayer;
 };
 
+// Betting state of a single street. Chip fields follow playStreetLog:
+// "first"/"second" mean player 1/player 2, not the order of action.
+struct StreetState {
+    bool preflop;
+    bool hasBet;
+    int raises;
+    bool finished;
+    int firstPlayer;             // 1 or 2, who opened the street
+    int current;                 // player to act (or who acted last once finished)
+    int actionCount;
+    int streetPot;
+    int firstPlayerChipsOnPot;
+    int secondPlayerChipsOnPot;
+    Action lastAction;
+};
+
+// Reset st for a new street. Preflop starts with the blinds posted (10/20),
+// the opener being the small blind.
+void streetStart(StreetState& st, bool preflop, int firstPlayer) {
+    st.preflop = preflop;
+    st.hasBet = false;
+    st.raises = 0;
+    st.finished = false;
+    st.firstPlayer = firstPlayer;
+    st.current = firstPlayer;
+    st.actionCount = 0;
+    st.streetPot = 0;
+    st.firstPlayerChipsOnPot = 0;
+    st.secondPlayerChipsOnPot = 0;
+    st.lastAction = A_CHECK;
+    if(preflop) {
+        st.hasBet = true;
+        st.firstPlayerChipsOnPot = (firstPlayer==1 ? 10 : 20);
+        st.secondPlayerChipsOnPot = (firstPlayer==1 ? 20 : 10);
+        st.streetPot = 30;
+    }
+}
+
+// Write the legal actions for the player to act into out[] and return how many.
+int legalActions(const StreetState& st, Action out[3]) {
+    if(!st.hasBet) { out[0] = A_CHECK; out[1] = A_BET; return 2; }
+    if(st.raises < MAX_RAISES) { out[0] = A_CALL; out[1] = A_RAISE; out[2] = A_FOLD; return 3; }
+    out[0] = A_CALL; out[1] = A_FOLD;
+    return 2;
+}
+
+// Same legality as a bitmask over Action values (bit a set = action a legal).
+inline int legalMask(const StreetState& st) {
+    if(!st.hasBet) return (1<<A_CHECK) | (1<<A_BET);
+    if(st.raises < MAX_RAISES) return (1<<A_CALL) | (1<<A_RAISE) | (1<<A_FOLD);
+    return (1<<A_CALL) | (1<<A_FOLD);
+}
+
+// Apply a legal action for st.current and advance to the next actor.
+void streetApply(StreetState& st, Action pick) {
+    int current = st.current;
+    st.lastAction = pick;
+    if(pick == A_BET) {
+        st.hasBet = true;
+        st.raises = 1; // first bet counts as a single bet/raise
+        st.streetPot = st.streetPot + 20;
+        st.firstPlayerChipsOnPot = st.firstPlayerChipsOnPot + (current==1 ? 20 : 0);
+        st.secondPlayerChipsOnPot = st.secondPlayerChipsOnPot + (current==1 ? 0 : 20);
+
+    } else if(pick == A_RAISE) {
+        if (st.actionCount >= 1 || st.preflop){
+           if (st.preflop && st.actionCount==0){
+            st.streetPot = st.streetPot + 30;
+            st.firstPlayerChipsOnPot = st.firstPlayerChipsOnPot + (current==1 ? 30 : 0);
+            st.secondPlayerChipsOnPot = st.secondPlayerChipsOnPot + (current==1 ? 0 : 30);
+           } else{
+            st.streetPot = st.streetPot + 40;
+            st.firstPlayerChipsOnPot = st.firstPlayerChipsOnPot + (current==1 ? 40 : 0);
+            st.secondPlayerChipsOnPot = st.secondPlayerChipsOnPot + (current==1 ? 0 : 40);
+           }
+
+        }
+
+        st.hasBet = true;
+        ++st.raises;
+    } else if(pick == A_CALL) {
+        if (st.actionCount >= 1 || st.preflop){
+           if (st.preflop && st.actionCount == 0){
+            st.streetPot = st.streetPot + 10;
+           } else{
+            st.streetPot = st.streetPot + 20;
+           }
+
+           st.firstPlayerChipsOnPot = st.firstPlayerChipsOnPot + (current==1 ? (st.secondPlayerChipsOnPot-st.firstPlayerChipsOnPot) : 0);
+           st.secondPlayerChipsOnPot = st.secondPlayerChipsOnPot + (current==1 ? 0 : (st.firstPlayerChipsOnPot-st.secondPlayerChipsOnPot));
+        }
+        // call completes and ends the street
+        st.finished = true;
+    } else if(pick == A_CHECK) {
+        // If both players checked in sequence, end street
+        if(st.actionCount > 0 && current != st.firstPlayer) st.finished = true;
+    } else if(pick == A_FOLD) {
+        st.finished = true;
+    }
+
+    // prepare next actor
+    if (st.finished != true) {
+        st.current = (current==1 ? 2 : 1);
+        ++st.actionCount;
+        if(st.actionCount > 12) { // safety net
+            st.finished = true;
+        }
+    }
+}
+
 
 // Play a street and print every action. We do not track chips/pot;
 // we only ensure legal action flow. firstPlayer is 1 or 2 starting actor.
-gameState playStreetLog(const string& streetName, int firstPlayer) {
+// Actions are drawn from the hand's generator g.
+gameState playStreetLog(const string& streetName, int firstPlayer, HandRng& g) {
     cout << "\n-- " << streetName << " --\n";
-    bool hasBet = false;
-    int raises = 0;
-    const int MAX_RAISES = 4;
-    bool finished = false;
-    int current = firstPlayer;
-    int actionCount = 0;
-    int streetPot = 0;
-    int firstPlayerChipsOnPot = 0;
-    int secondPlayerChipsOnPot = 0;
-    string pickAction;
-    if (streetName == "Preflop"){
-            hasBet = true;
-            firstPlayerChipsOnPot = (current==1 ? 10 : 20);
-            secondPlayerChipsOnPot = (current==1 ? 20 : 10);
-            streetPot = 30;
-        }
-    while(!finished) {
-        vector<Action> allowed;
-        
-        if(!hasBet) allowed = {A_CHECK, A_BET};
-        else {
-            if(raises < MAX_RAISES) allowed = {A_CALL, A_RAISE, A_FOLD};
-            else allowed = {A_CALL, A_FOLD};
-        }
-        Action pick = pickRandom(allowed);
-        cout << "Player " << current << ": " << actionStr(pick) << "\n";
-        pickAction = actionStr(pick);
-        if(pick == A_BET) {
-            hasBet = true;
-            raises = 1; // first bet counts as a single bet/raise
-            streetPot = streetPot + 20;
-            firstPlayerChipsOnPot = firstPlayerChipsOnPot + (current==1 ? 20 : 0);
-            secondPlayerChipsOnPot = secondPlayerChipsOnPot + (current==1 ? 0 : 20);
-
-        } else if(pick == A_RAISE) {
-            if (actionCount >= 1 || streetName == "Preflop"){ 
-               if (streetName == "Preflop" & actionCount==0){
-                streetPot = streetPot + 30;
-                firstPlayerChipsOnPot = firstPlayerChipsOnPot + (current==1 ? 30 : 0);
-                secondPlayerChipsOnPot = secondPlayerChipsOnPot + (current==1 ? 0 : 30);
-               } else{
-                streetPot = streetPot + 40;
-                firstPlayerChipsOnPot = firstPlayerChipsOnPot + (current==1 ? 40 : 0);
-                secondPlayerChipsOnPot = secondPlayerChipsOnPot + (current==1 ? 0 : 40);
-               }
-               
-            }
-
-            hasBet = true;
-            ++raises;
-        } else if(pick == A_CALL) {
-            if (actionCount >= 1 || streetName == "Preflop"){ 
-               if (streetName == "Preflop" && actionCount == 0){
-                streetPot = streetPot + 10;
-               } else{
-                streetPot = streetPot + 20;
-               }
-               
-               firstPlayerChipsOnPot = firstPlayerChipsOnPot + (current==1 ? (secondPlayerChipsOnPot-firstPlayerChipsOnPot) : 0);
-               secondPlayerChipsOnPot = secondPlayerChipsOnPot + (current==1 ? 0 : (firstPlayerChipsOnPot-secondPlayerChipsOnPot));
-            }
-            // call completes and ends the street
-            finished = true;
-        } else if(pick == A_CHECK) {
-            // If both players checked in sequence, end street
-            if(actionCount > 0 && current != firstPlayer) finished = true;
-        } else if(pick == A_FOLD) {
-            // If both players checked in sequence, end street
-            //if (current != firstPlayer) {
-            //   firstPlayerChipsOnPot = firstPlayerChipsOnPot + streetPot;
-            //} else {
-            //   secondPlayerChipsOnPot = secondPlayerChipsOnPot + streetPot;
-            //}
-           
-            finished = true;
-        }
-
-        // prepare next actor
-        if (finished != true) {
-            current = (current==1 ? 2 : 1);
-            ++actionCount;
-            if(actionCount > 12) { // safety net
-                finished = true;
-            }
-        }
-        
+    StreetState st;
+    streetStart(st, streetName == "Preflop", firstPlayer);
+    while(!st.finished) {
+        Action buf[3];
+        int n = legalActions(st, buf);
+        Action pick = pickRandom(buf, n, g);
+        cout << "Player " << st.current << ": " << actionStr(pick) << "\n";
+        streetApply(st, pick);
     }
     gameState currentState;
-    currentState.pot = streetPot;
-    currentState.firstPlayerChips = firstPlayerChipsOnPot;
-    currentState.secondPlayerChips = secondPlayerChipsOnPot;
-    currentState.lastStreetAction = pickAction;
-    currentState.lastActingPlayer = current;
+    currentState.pot = st.streetPot;
+    currentState.firstPlayerChips = st.firstPlayerChipsOnPot;
+    currentState.secondPlayerChips = st.secondPlayerChipsOnPot;
+    currentState.lastStreetAction = st.lastAction;
+    currentState.lastActingPlayer = st.current;
 
     return currentState;
 }
 
+/* Action histories as integers. Every legal betting sequence of a
+   street is a node of a small automaton (one for preflop, one for the
+   later streets), generated from streetStart/legalActions/streetApply.
+   A whole-hand history packs the automaton node of each street into
+   HIST_BITS bits plus the current street, so append, parent and
+   legality are table lookups and the key fits in 32 bits:
+     bits 0..23   node on preflop, flop, turn, river (6 bits each)
+     bits 24..25  current street
+   A street that ends with a call or check-check moves the key to
+   node 0 of the next street; a fold (or the end of the river) is
+   terminal. */
+
+typedef uint32_t HistoryKey;
+const int HIST_BITS = 6;
+const int HIST_STREET_SHIFT = 24;
+const HistoryKey HISTORY_ROOT = 0;
+
+const char* const STREET_NAMES[4] = {"Preflop", "Flop", "Turn", "River"};
+
+struct StreetAutomaton {
+    struct Node {
+        int parent;                 // -1 for the street root
+        Action last;                // action leading here
+        int child[NUM_ACTIONS];     // -1 if illegal
+        uint8_t legal;              // legalMask of the node
+        bool finished;              // street over after `last`
+        bool folded;
+        uint8_t actor;              // to act: 0 the street's opener, 1 the other player
+        int16_t chips[2];           // put in on this street by the opener / the other player
+    };
+    vector<Node> nodes;
+
+    void build(bool preflop) {
+        nodes.clear();
+        StreetState st;
+        streetStart(st, preflop, 1);
+        add(-1, A_CHECK, st);
+    }
+
+    int add(int parent, Action last, const StreetState& st) {
+        int id = (int)nodes.size();
+        Node n;
+        n.parent = parent;
+        n.last = last;
+        fill(n.child, n.child + NUM_ACTIONS, -1);
+        n.finished = st.finished;
+        n.folded = st.finished && st.lastAction == A_FOLD;
+        n.legal = (uint8_t)(st.finished ? 0 : legalMask(st));
+        n.actor = (uint8_t)(st.current - 1);    // built with player 1 opening
+        n.chips[0] = (int16_t)st.firstPlayerChipsOnPot;
+        n.chips[1] = (int16_t)st.secondPlayerChipsOnPot;
+        nodes.push_back(n);
+        if(st.finished) return id;
+        Action buf[3];
+        int cnt = legalActions(st, buf);
+        for(int k=0;k<cnt;++k) {
+            StreetState nx = st;
+            streetApply(nx, buf[k]);
+            int c = add(id, buf[k], nx);
+            nodes[id].child[buf[k]] = c;
+        }
+        return id;
+    }
+};
+
+struct HistoryTables {
+    StreetAutomaton street[2];      // [0] preflop, [1] flop/turn/river
+    HistoryTables() { street[0].build(true); street[1].build(false); }
+};
+static const HistoryTables HISTORY;
+
+inline const StreetAutomaton& automatonFor(int street) { return HISTORY.street[street == 0 ? 0 : 1]; }
+inline int historyStreet(HistoryKey h) { return (h >> HIST_STREET_SHIFT) & 3; }
+inline int historyNode(HistoryKey h, int street) { return (h >> (street*HIST_BITS)) & ((1 << HIST_BITS) - 1); }
+
+inline HistoryKey historyWithNode(HistoryKey h, int street, int node) {
+    int shift = street*HIST_BITS;
+    return (h & ~(((1u << HIST_BITS) - 1) << shift)) | ((HistoryKey)node << shift);
+}
+
+// True once the hand is over: someone folded or the river betting closed.
+inline bool historyTerminal(HistoryKey h) {
+    int s = historyStreet(h);
+    const StreetAutomaton::Node& n = automatonFor(s).nodes[historyNode(h, s)];
+    return n.folded || (s == 3 && n.finished);
+}
+
+// legalMask of the player to act (0 when terminal)
+inline int historyLegalMask(HistoryKey h) {
+    int s = historyStreet(h);
+    return automatonFor(s).nodes[historyNode(h, s)].legal;
+}
+
+// Append a legal action; a finished street moves on to the next one.
+inline HistoryKey historyAppend(HistoryKey h, Action a) {
+    int s = historyStreet(h);
+    int next = automatonFor(s).nodes[historyNode(h, s)].child[a];
+    h = historyWithNode(h, s, next);
+    const StreetAutomaton::Node& n = automatonFor(s).nodes[next];
+    if(n.finished && !n.folded && s < 3)
+        h = (h & ~(3u << HIST_STREET_SHIFT)) | ((HistoryKey)(s + 1) << HIST_STREET_SHIFT);
+    return h;
+}
+
+// History before the last action (HISTORY_ROOT stays HISTORY_ROOT).
+inline HistoryKey historyParent(HistoryKey h) {
+    int s = historyStreet(h);
+    int node = historyNode(h, s);
+    if(node == 0 && s > 0) {
+        --s;
+        node = historyNode(h, s);
+        h = (h & ~(3u << HIST_STREET_SHIFT)) | ((HistoryKey)s << HIST_STREET_SHIFT);
+    }
+    if(node == 0) return h;
+    return historyWithNode(h, s, automatonFor(s).nodes[node].parent);
+}
+
+// Player (1 or 2) to act; firstToAct opens preflop, the other player
+// opens the later streets.
+inline int historyToAct(HistoryKey h, int firstToAct) {
+    int s = historyStreet(h);
+    int opener = (s == 0 ? firstToAct : 3 - firstToAct);
+    return automatonFor(s).nodes[historyNode(h, s)].actor ? 3 - opener : opener;
+}
+
+// Chips put in so far by player 1 and player 2, blinds included.
+inline void historyChips(HistoryKey h, int firstToAct, int chips[2]) {
+    chips[0] = chips[1] = 0;
+    for(int s=0; s<=historyStreet(h); ++s) {
+        const StreetAutomaton::Node& n = automatonFor(s).nodes[historyNode(h, s)];
+        int opener = (s == 0 ? firstToAct : 3 - firstToAct) - 1;
+        chips[opener] += n.chips[0];
+        chips[1 - opener] += n.chips[1];
+    }
+}
+
+// Actions of one street, in order.
+int historyStreetActions(HistoryKey h, int street, Action* out) {
+    const StreetAutomaton& a = automatonFor(street);
+    int n = 0;
+    for(int node = historyNode(h, street); node > 0; node = a.nodes[node].parent) out[n++] = a.nodes[node].last;
+    reverse(out, out + n);
+    return n;
+}
+
+// The history in playStreetLog's format ("-- Flop --" headers, "Player N: action"
+// lines). firstToAct opens preflop; the other player opens later streets.
+string historyToLog(HistoryKey h, int firstToAct) {
+    string out;
+    Action acts[MAX_RAISES + 4];
+    for(int s=0; s<=historyStreet(h); ++s) {
+        int n = historyStreetActions(h, s, acts);
+        if(n == 0) break;
+        int player = (s == 0 ? firstToAct : (firstToAct == 1 ? 2 : 1));
+        out += string("\n-- ") + STREET_NAMES[s] + " --\n";
+        for(int i=0;i<n;++i) {
+            out += "Player " + to_string(player) + ": " + actionStr(acts[i]) + "\n";
+            player = (player == 1 ? 2 : 1);
+        }
+    }
+    return out;
+}
+
+// Parse "Player N: action" lines (other lines are ignored) back into a key.
+// Returns false on an unknown or illegal action.
+bool historyFromLog(const string& text, HistoryKey& out) {
+    HistoryKey h = HISTORY_ROOT;
+    istringstream in(text);
+    string line;
+    while(getline(in, line)) {
+        if(line.compare(0, 7, "Player ") != 0) continue;
+        size_t colon = line.find(": ");
+        if(colon == string::npos) continue;
+        string word = line.substr(colon + 2);
+        int a = 0;
+        while(a < NUM_ACTIONS && actionStr((Action)a) != word) ++a;
+        if(a == NUM_ACTIONS || historyTerminal(h) || !((historyLegalMask(h) >> a) & 1)) return false;
+        h = historyAppend(h, (Action)a);
+    }
+    out = h;
+    return true;
+}
+
+// Key for reaching the start of `street` with both players just calling/checking:
+// preflop call, then check-check. Used when earlier betting is not known.
+HistoryKey historyLimpedTo(int street) {
+    HistoryKey h = HISTORY_ROOT;
+    if(street > 0) h = historyAppend(h, A_CALL);
+    for(int s=1; s<street; ++s) h = historyAppend(historyAppend(h, A_CHECK), A_CHECK);
+    return h;
+}
+
+/* Make/unmake hand state for tree search. The whole hand fits in a few
+   hundred bytes: the dealt cards, the betting as a HistoryKey with the
+   chips, player to act and legal mask it implies, and a fixed undo
+   stack of those frames. apply() reads the street automaton once and
+   undo() pops a frame, so searches step through millions of nodes
+   without copying states or allocating. */
+
+const int HAND_CARDS = 9;           // hole cards of player 1, of player 2, then the board
+
+enum HandStatus : uint8_t { HAND_IN_PLAY, HAND_FOLDED, HAND_SHOWDOWN };
+
+struct HandState {
+    struct Frame {
+        HistoryKey history;
+        int16_t chips[2];           // put in by player 1 / player 2, blinds included
+        uint8_t toAct;              // 1 or 2; the folder once folded
+        uint8_t legal;              // legalMask, 0 when over
+        HandStatus status;
+    };
+    uint8_t cards[HAND_CARDS];      // cardIndex
+    uint8_t firstToAct;             // 1 or 2, opens preflop
+    uint8_t depth;                  // actions applied
+    Frame cur;
+    Frame undoStack[MAX_HAND_ACTIONS];
+
+    void reset(const int* cardIdx, int opener) {
+        for(int i=0;i<HAND_CARDS;++i) cards[i] = (uint8_t)cardIdx[i];
+        firstToAct = (uint8_t)opener;
+        depth = 0;
+        const StreetAutomaton::Node& root = automatonFor(0).nodes[0];
+        cur.history = HISTORY_ROOT;
+        cur.chips[opener - 1] = root.chips[0];
+        cur.chips[2 - opener] = root.chips[1];
+        cur.toAct = (uint8_t)opener;
+        cur.legal = root.legal;
+        cur.status = HAND_IN_PLAY;
+    }
+
+    void apply(Action a) {
+        undoStack[depth++] = cur;
+        int s = historyStreet(cur.history);
+        const StreetAutomaton& A = automatonFor(s);
+        const StreetAutomaton::Node& from = A.nodes[historyNode(cur.history, s)];
+        const StreetAutomaton::Node& to = A.nodes[from.child[a]];
+        int opener = (s == 0 ? firstToAct : 3 - firstToAct);
+        cur.chips[opener - 1] += to.chips[0] - from.chips[0];
+        cur.chips[2 - opener] += to.chips[1] - from.chips[1];
+        cur.history = historyWithNode(cur.history, s, from.child[a]);
+        if(to.finished && !to.folded && s < 3)
+            cur.history = (cur.history & ~(3u << HIST_STREET_SHIFT)) | ((HistoryKey)(s + 1) << HIST_STREET_SHIFT);
+        cur.toAct = (uint8_t)(to.actor ? 3 - opener : opener);
+        cur.legal = to.legal;
+        cur.status = HAND_IN_PLAY;
+        if(to.folded) cur.status = HAND_FOLDED;
+        else if(to.finished && s == 3) cur.status = HAND_SHOWDOWN;
+        else if(to.finished) {
+            cur.toAct = (uint8_t)(3 - firstToAct);
+            cur.legal = automatonFor(1).nodes[0].legal;
+        }
+    }
+    void undo() { cur = undoStack[--depth]; }
+
+    bool terminal() const { return cur.status != HAND_IN_PLAY; }
+    int legal() const { return cur.legal; }
+    int street() const { return historyStreet(cur.history); }
+    int toAct() const { return cur.toAct; }
+
+    // 1 or 2 for the player whose seven cards are better, 0 for a tie.
+    // It only depends on the deal, so searches compute it once per deal.
+    int showdownWinner(const FastEvaluator& eval) const {
+        int idx[2];
+        for(int p=0;p<2;++p) {
+            int seven[7];
+            seven[0] = encodeCard(cards[2*p] % 13 + 2, cards[2*p] / 13);
+            seven[1] = encodeCard(cards[2*p + 1] % 13 + 2, cards[2*p + 1] / 13);
+            for(int i=0;i<5;++i) seven[2+i] = encodeCard(cards[4+i] % 13 + 2, cards[4+i] / 13);
+            idx[p] = eval.eval7(seven);
+        }
+        return idx[0] < idx[1] ? 1 : idx[1] < idx[0] ? 2 : 0;
+    }
+
+    // Chips won by player 1 in a finished hand, given showdownWinner().
+    int payoff(int winner) const {
+        if(cur.status == HAND_FOLDED) winner = 3 - cur.toAct;
+        return winner == 1 ? cur.chips[1] : winner == 2 ? -cur.chips[0] : 0;
+    }
+};
+
+// Sum of player 1 payoffs over every betting line of st's deal, walked
+// with apply/undo; nodes counts the states visited.
+long long handTreeSum(HandState& st, int winner, long long& nodes) {
+    ++nodes;
+    if(st.terminal()) return st.payoff(winner);
+    long long sum = 0;
+    for(int mask = st.legal(); mask; mask &= mask - 1) {
+        st.apply((Action)__builtin_ctz(mask));
+        sum += handTreeSum(st, winner, nodes);
+        st.undo();
+    }
+    return sum;
+}
+
+// The same walk with every child copying its parent's HandState.
+long long handTreeSumCopy(const HandState& st, int winner, long long& nodes) {
+    ++nodes;
+    if(st.terminal()) return st.payoff(winner);
+    long long sum = 0;
+    for(int mask = st.legal(); mask; mask &= mask - 1) {
+        HandState child = st;
+        child.apply((Action)__builtin_ctz(mask));
+        sum += handTreeSumCopy(child, winner, nodes);
+    }
+    return sum;
+}
+
+// Reference walk straight on the street rules (streetStart/streetApply),
+// carrying the chips along.
+long long streetTreeSum(const StreetState& st, int street, int firstToAct, int chips1, int chips2,
+                        int winner, long long& nodes) {
+    ++nodes;
+    long long sum = 0;
+    Action buf[3];
+    int n = legalActions(st, buf);
+    for(int k=0;k<n;++k) {
+        StreetState nx = st;
+        streetApply(nx, buf[k]);
+        if(!nx.finished) { sum += streetTreeSum(nx, street, firstToAct, chips1, chips2, winner, nodes); continue; }
+        int c1 = chips1 + nx.firstPlayerChipsOnPot, c2 = chips2 + nx.secondPlayerChipsOnPot;
+        if(nx.lastAction == A_FOLD) { ++nodes; sum += (nx.current == 1 ? -c1 : c2); continue; }
+        if(street == 3) { ++nodes; sum += (winner == 1 ? c2 : winner == 2 ? -c1 : 0); continue; }
+        StreetState next;
+        streetStart(next, false, 3 - firstToAct);
+        sum += streetTreeSum(next, street + 1, firstToAct, c1, c2, winner, nodes);
+    }
+    return sum;
+}
+
+// Mode "makeunmake": walk the full betting tree of random deals with
+// HandState apply/undo and with HandState copies, timing both; payoffs
+// must agree with the walk on the street rules.
+int runMakeUnmake(int deals, const CanonTable& table) {
+    FastEvaluator eval;
+    eval.build(table);
+    long long nodesHS = 0, nodesCopy = 0, nodesRef = 0, mismatches = 0, total = 0;
+    double secsHS = 0, secsCopy = 0;
+    for(int d=1; d<=deals; ++d) {
+        HandRng g(rd(), (uint64_t)d);
+        int deck[52], cards[HAND_CARDS];
+        for(int i=0;i<52;++i) deck[i] = i;
+        for(int i=0;i<HAND_CARDS;++i) { swap(deck[i], deck[i + g.below(52 - i)]); cards[i] = deck[i]; }
+        HandState st;
+        st.reset(cards, d % 2 != 0 ? 1 : 2);
+        int winner = st.showdownWinner(eval);
+
+        auto t0 = chrono::steady_clock::now();
+        long long a = handTreeSum(st, winner, nodesHS);
+        auto t1 = chrono::steady_clock::now();
+        StreetState pre;
+        streetStart(pre, true, st.firstToAct);
+        long long b = handTreeSumCopy(st, winner, nodesCopy);
+        auto t2 = chrono::steady_clock::now();
+        long long c = streetTreeSum(pre, 0, st.firstToAct, 0, 0, winner, nodesRef);
+        secsHS += chrono::duration<double>(t1 - t0).count();
+        secsCopy += chrono::duration<double>(t2 - t1).count();
+        if(a != b || a != c || st.depth != 0 || st.cur.history != HISTORY_ROOT) ++mismatches;
+        total += a;
+    }
+    cout << "Deals: " << deals << "  Nodes per deal: " << nodesHS / max(1, deals)
+         << "  Player 1 payoff sum: " << total << "  Mismatches: " << mismatches << "\n";
+    cout << "HandState apply/undo: " << nodesHS / secsHS / 1e6 << " M nodes/s\n";
+    cout << "HandState copies:     " << nodesCopy / secsCopy / 1e6 << " M nodes/s\n";
+    cout << "sizeof(HandState) = " << sizeof(HandState) << " bytes\n";
+    return mismatches ? 1 : 0;
+}
+
+// Mode "history": walk every betting history of a hand, check that keys
+// survive the log round trip and that parent undoes append.
+int runHistoryCheck() {
+    long long keys = 0, terminals = 0, failures = 0;
+    vector<HistoryKey> stack = {HISTORY_ROOT};
+    while(!stack.empty()) {
+        HistoryKey h = stack.back();
+        stack.pop_back();
+        ++keys;
+        HistoryKey back;
+        if(!historyFromLog(historyToLog(h, 1), back) || back != h) ++failures;
+        if(historyTerminal(h)) { ++terminals; continue; }
+        int mask = historyLegalMask(h);
+        for(int a=0;a<NUM_ACTIONS;++a) {
+            if(!((mask >> a) & 1)) continue;
+            HistoryKey c = historyAppend(h, (Action)a);
+            if(historyParent(c) != h) ++failures;
+            stack.push_back(c);
+        }
+    }
+    cout << "Street automaton nodes: preflop " << HISTORY.street[0].nodes.size()
+         << ", postflop " << HISTORY.street[1].nodes.size() << "\n";
+    cout << "Histories: " << keys << " (" << terminals << " terminal)  Round-trip failures: " << failures << "\n";
+
+    // random walks to time append/legality queries
+    const int WALKS = 1000000;
+    long long steps = 0;
+    HistoryKey sink = 0;
+    auto t0 = chrono::steady_clock::now();
+    for(int w=0; w<WALKS; ++w) {
+        HistoryKey h = HISTORY_ROOT;
+        while(!historyTerminal(h)) {
+            int mask = historyLegalMask(h);
+            int a = __builtin_ctz(mask);
+            int pick = (w + steps) % __builtin_popcount(mask);
+            for(int k=0;k<pick;++k) a = __builtin_ctz(mask &= mask - 1);
+            h = historyAppend(h, (Action)a);
+            ++steps;
+        }
+        sink ^= h;
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << "Appends: " << steps / secs << " /s (checksum " << sink << ")\n";
+    return failures == 0 ? 0 : 1;
+}
+
 /* ------------------------------------------------------------------
-   SECTION G — Simulation: play n hands (we will do 3)
-   Each hand prints hole cards, each street with actions, final board,
-   and final showdown with both players' best-class index (1..7462).
+   SECTION G — Batched decisions: many hands in lockstep
+   Model-driven bots are far cheaper to query once for a batch of
+   observations than once per decision. LockstepRunner keeps a fixed
+   number of hands in flight, writes every pending decision into one
+   contiguous int32 buffer (rows of OBS_WIDTH), calls the policy once
+   for the whole batch and scatters the chosen actions back. A hand
+   that finishes is immediately replaced by the next one so the batch
+   stays full until the run is nearly done.
    ------------------------------------------------------------------ */
 
-int main() {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
+// Observation row layout (all int32). Cards use cardIndex (0..51), -1 = not dealt yet.
+// History entries are 1 + street*NUM_ACTIONS + action, 0 = empty slot.
+enum ObsField {
+    OBS_PLAYER      = 0,   // seat to act, 1 or 2
+    OBS_STREET      = 1,   // 0 preflop, 1 flop, 2 turn, 3 river
+    OBS_HOLE        = 2,   // 2 entries: acting player's hole cards
+    OBS_BOARD       = 4,   // 5 entries: visible board cards
+    OBS_POT         = 9,   // chips in the pot
+    OBS_MY_CHIPS    = 10,  // chips the acting player has put in
+    OBS_OPP_CHIPS   = 11,  // chips the opponent has put in
+    OBS_NUM_ACTIONS = 12,  // entries used in the history
+    OBS_HISTORY     = 13,  // MAX_HAND_ACTIONS entries
+    OBS_WIDTH       = OBS_HISTORY + MAX_HAND_ACTIONS
+};
 
-    // Build canonical table once
-    CanonTable table;
-    table.build();
-    // Sanity check: number of classes should be 7462
-    cout << "Expect 7462 distinct classes. Found: " << table.classes.size() << "\n";
+// Board cards visible on each street
+const int BOARD_VISIBLE[4] = {0, 3, 4, 5};
 
-    // Simulate 3 hands
-    const int NUM_HANDS = 3;
-    for(int hnum=1; hnum<=NUM_HANDS; ++hnum) {
-        cout << "\n==================================================\n";
-        cout << "HAND #" << hnum << "\n";
+// One hand being played without blocking on decisions.
+struct LockstepHand {
+    int hole[2][2];             // [player-1][card]
+    int board[5];
+    int street;                 // 0..3 while in play
+    int firstToAct, secondToAct;
+    StreetState st;
+    int pot;                    // chips from completed streets
+    int chips[2];               // chips put in by player 1/2 on completed streets
+    int history[MAX_HAND_ACTIONS];
+    int numActions;
+    bool done;
+    int result;                 // chips won by player 1 (negative = lost), valid when done
+};
 
-        Deck deck;
-        deck.reset();
-        deck.shuffle();
-        int chips1 = 10000;
-        int chips2 = 10000;
-        string action = "";
-        int pot = 0;
-        int firstToAct = 1;
-        int secondToAct = 2;
-        bool folded = false;
-
-        //gameState blindsState = playStreetLog("Blinds", 1);
-
-        vector<int> p1 = { deck.deal(), deck.deal() };
-        vector<int> p2 = { deck.deal(), deck.deal() };
-        vector<int> board = { deck.deal(), deck.deal(), deck.deal(), deck.deal(), deck.deal() };
-
-        cout << "Player 1: " << cardToString(p1[0]) << ", " << cardToString(p1[1]) << "\n";
-        cout << "Player 2: " << cardToString(p2[0]) << ", " << cardToString(p2[1]) << "\n";
-        
-        // Check for divisibility by 2
-        if (hnum % 2 != 0) {
-            firstToAct = 1;
-            secondToAct = 2;
-        } else {
-            firstToAct = 2;
-            secondToAct = 1;
-        }
-        
-        // Preflop (player 1 acts first)
-        gameState preflopState = playStreetLog("Preflop", firstToAct);
-        //action = playStreetLog("Preflop", 1);
-        action = preflopState.lastStreetAction;
-        pot = preflopState.pot;
-        int firstPlayerChips = preflopState.firstPlayerChips;
-        int secondPlayerChips = preflopState.secondPlayerChips;
-        cout << "Last preflop action: " << action << ", " << "Pot: " << pot << " firstPlayerChipsOnPot: " << firstPlayerChips << " secondPlayerChipsOnPot: " << secondPlayerChips << "\n";
-        //playStreetLog("Preflop", 1);
-
-        // Flop
-        if (action != "fold"){
-            cout << "Flop: " << cardToString(board[0]) << ", " << cardToString(board[1]) << ", " << cardToString(board[2]) << "\n";
-            //action = playStreetLog("Flop", 1);
-            gameState flopState = playStreetLog("Flop", secondToAct);
-            action = flopState.lastStreetAction;
-            pot = pot + flopState.pot;
-            firstPlayerChips = firstPlayerChips + flopState.firstPlayerChips;
-            secondPlayerChips = secondPlayerChips + flopState.secondPlayerChips;
-            cout << "Last flop action: " << action << ", " << "Pot: " << pot << " firstPlayerChipsOnPot: " << firstPlayerChips << " secondPlayerChipsOnPot: " << secondPlayerChips << "\n";
-        } else {
-            if(firstPlayerChips > secondPlayerChips){
-                cout << "secondplayer folded preflop" << " firstplayer wins: " << secondPlayerChips << "\n";
-            } else{
-                cout << "firstplayer folded preflop" << " second player wins: " << firstPlayerChips << "\n";
-            }
-            folded = true;
-        }
+// Deal a new hand. Odd hand numbers let player 1 open preflop, as in main.
+// g is the hand's own generator, so the deal matches a replay of that hand.
+void lockstepDeal(LockstepHand& h, int handNumber, HandRng& g) {
+    Deck deck;
+    deck.shuffle(g);
+    h.hole[0][0] = deck.deal(); h.hole[0][1] = deck.deal();
+    h.hole[1][0] = deck.deal(); h.hole[1][1] = deck.deal();
+    for(int i=0;i<5;++i) h.board[i] = deck.deal();
+    h.firstToAct = (handNumber % 2 != 0 ? 1 : 2);
+    h.secondToAct = (h.firstToAct == 1 ? 2 : 1);
+    h.street = 0;
+    h.pot = 0;
+    h.chips[0] = h.chips[1] = 0;
+    h.numActions = 0;
+    h.done = false;
+    h.result = 0;
+    streetStart(h.st, true, h.firstToAct);
+}
 
-        // Turn
-        if (action != "fold"){
-            cout << "Turn: " << cardToString(board[3]) << "\n";
-            //action = playStreetLog("Turn", 1);
-            gameState turnState = playStreetLog("Turn", secondToAct);
-            action = turnState.lastStreetAction;
-            pot = pot + turnState.pot;
-            firstPlayerChips = firstPlayerChips + turnState.firstPlayerChips;
-            secondPlayerChips = secondPlayerChips + turnState.secondPlayerChips;
-            cout << "Last turn action: " << action << ", " << "Pot: " << pot << " firstPlayerChipsOnPot: " << firstPlayerChips << " secondPlayerChipsOnPot: " << secondPlayerChips << "\n";
-        } else {
-            if (folded == false){
-                if(firstPlayerChips > secondPlayerChips){
-                    cout << "secondplayer folded flop" << " firstplayer wins: " << secondPlayerChips << "\n";
-                } else{
-                    cout << "firstplayer folded flop" << " second player wins: " << firstPlayerChips << "\n";
-                }
-                folded = true;
-            }
-        }
-
-        // River
-        if (action != "fold"){
-            cout << "River: " << cardToString(board[4]) << "\n";
-            //action = playStreetLog("River", 1);
-            gameState riverState = playStreetLog("River", secondToAct);
-            action = riverState.lastStreetAction;
-            pot = pot + riverState.pot;
-            firstPlayerChips = firstPlayerChips + riverState.firstPlayerChips;
-            secondPlayerChips = secondPlayerChips + riverState.secondPlayerChips;
-            cout << "Last river action: " << action << ", " << "Pot: " << pot << " firstPlayerChipsOnPot: " << firstPlayerChips << " secondPlayerChipsOnPot: " << secondPlayerChips << "\n";
-            if (action != "fold"){
-                // Showdown: evaluate both players' best 5-card class from 7 cards
-                vector<int> all1 = p1; all1.insert(all1.end(), board.begin(), board.end());
-                vector<int> all2 = p2; all2.insert(all2.end(), board.begin(), board.end());
-                int idx1 = evaluate7_bestIndex(all1, table);
-                int idx2 = evaluate7_bestIndex(all2, table);
-
-                // For user-friendliness also compute the HandClass to print category
-                // We re-evaluate best HandClass (we could modify evaluate7_bestIndex to return it)
-                HandClass bestHC1, bestHC2;
-                bool hb1=false, hb2=false;
-                array<int,5> combo;
-                for(int a=0;a<7;a++) for(int b=a+1;b<7;b++) for(int c=b+1;c<7;c++)
-                for(int d=c+1;d<7;d++) for(int e=d+1;e<7;e++){
-                    combo = { all1[a], all1[b], all1[c], all1[d], all1[e] };
-                    HandClass hc = classify5(combo);
-                    if(!hb1 || handClassBetter(hc, bestHC1)) { bestHC1 = hc; hb1=true; }
-                    combo = { all2[a], all2[b], all2[c], all2[d], all2[e] };
-                    HandClass hc2 = classify5(combo);
-                    if(!hb2 || handClassBetter(hc2, bestHC2)) { bestHC2 = hc2; hb2=true; }
-                }
+// Apply the action of the player to act; settles the hand when it ends.
+void lockstepApply(LockstepHand& h, Action a, const CanonTable& table) {
+    if(h.numActions < MAX_HAND_ACTIONS)
+        h.history[h.numActions++] = 1 + h.street*NUM_ACTIONS + a;
+    streetApply(h.st, a);
+    if(!h.st.finished) return;
+
+    h.pot += h.st.streetPot;
+    h.chips[0] += h.st.firstPlayerChipsOnPot;
+    h.chips[1] += h.st.secondPlayerChipsOnPot;
+    if(h.st.lastAction == A_FOLD) {
+        // the folder forfeits what they have put in
+        h.result = (h.st.current == 1 ? -h.chips[0] : h.chips[1]);
+        h.done = true;
+        return;
+    }
+    if(h.street == 3) {
+        int all1[7] = {h.hole[0][0], h.hole[0][1]};
+        int all2[7] = {h.hole[1][0], h.hole[1][1]};
+        copy(h.board, h.board + 5, all1 + 2);
+        copy(h.board, h.board + 5, all2 + 2);
+        int idx1 = evaluate7_bestIndex(all1, table);
+        int idx2 = evaluate7_bestIndex(all2, table);
+        if(idx1 < idx2) h.result = h.chips[1];
+        else if(idx2 < idx1) h.result = -h.chips[0];
+        else h.result = 0;
+        h.done = true;
+        return;
+    }
+    ++h.street;
+    streetStart(h.st, false, h.secondToAct);
+}
 
-                cout << "\n-- Showdown --\n";
-                cout << "Board: " << cardToString(board[0]) << ", " << cardToString(board[1]) << ", "
-                    << cardToString(board[2]) << ", " << cardToString(board[3]) << ", " << cardToString(board[4]) << "\n\n";
+// Write the observation of the player to act into row[0..OBS_WIDTH).
+void lockstepEncode(const LockstepHand& h, int32_t* row) {
+    int me = h.st.current - 1;
+    int streetChips[2] = { h.st.firstPlayerChipsOnPot, h.st.secondPlayerChipsOnPot };
+    row[OBS_PLAYER] = h.st.current;
+    row[OBS_STREET] = h.street;
+    row[OBS_HOLE]     = cardIndex(h.hole[me][0]);
+    row[OBS_HOLE + 1] = cardIndex(h.hole[me][1]);
+    for(int i=0;i<5;++i)
+        row[OBS_BOARD + i] = (i < BOARD_VISIBLE[h.street] ? cardIndex(h.board[i]) : -1);
+    row[OBS_POT] = h.pot + h.st.streetPot;
+    row[OBS_MY_CHIPS] = h.chips[me] + streetChips[me];
+    row[OBS_OPP_CHIPS] = h.chips[1-me] + streetChips[1-me];
+    row[OBS_NUM_ACTIONS] = h.numActions;
+    for(int i=0;i<MAX_HAND_ACTIONS;++i)
+        row[OBS_HISTORY + i] = (i < h.numActions ? h.history[i] : 0);
+}
 
-                cout << "Player 1: " << cardToString(p1[0]) << ", " << cardToString(p1[1]) << "\n";
-                cout << "  Category: " << categoryName(bestHC1.category)
-                    << "  Index: " << idx1 << " (1=best, 7462=worst)\n";
+// Batched policy: obs is batch x OBS_WIDTH (row-major), legal[i] is the
+// legalMask of row i. The policy writes one action per row into out.
+typedef function<void(const int32_t* obs, const uint8_t* legal, int batch, Action* out)> BatchPolicy;
 
-                cout << "Player 2: " << cardToString(p2[0]) << ", " << cardToString(p2[1]) << "\n";
-                cout << "  Category: " << categoryName(bestHC2.category)
-                    << "  Index: " << idx2 << " (1=best, 7462=worst)\n";
+struct LockstepStats {
+    long long hands = 0;
+    long long decisions = 0;
+    long long batches = 0;
+    long long p1Net = 0;        // sum of player 1 results
+};
 
-                if(idx1 < idx2) cout << "Result: Player 1 wins "  << secondPlayerChips << "(lower index = better)\n";
-                else if(idx2 < idx1) cout << "Result: Player 2 wins" << firstPlayerChips << "\n";
-                else cout << "Result: Tie (equal index)\n";
-            } else {
-            if(firstPlayerChips > secondPlayerChips){
-                cout << "secondplayer folded river" << " firstplayer wins: " << secondPlayerChips << "\n";
-            } else{
-                cout << "firstplayer folded river" << " second player wins: " << firstPlayerChips << "\n";
-            }
+struct LockstepRunner {
+    int batchSize;
+    vector<LockstepHand> slots;
+    vector<int32_t> obs;        // batchSize x OBS_WIDTH
+    vector<uint8_t> legal;      // batchSize
+    vector<Action> actions;     // batchSize
+    vector<int> rowSlot;        // row -> slot
+    uint64_t runSeed;           // hand n is dealt from HandRng(runSeed, n)
+
+    // Optional hooks for recorders: every applied decision (with the row it
+    // was taken from) and every finished hand, identified by slot.
+    function<void(int slot, const int32_t* obs, Action a)> onDecision;
+    function<void(int slot, const LockstepHand& h)> onHandDone;
+
+    explicit LockstepRunner(int batch, uint64_t seed = random_device{}()) : batchSize(batch),
+        slots(batch), obs((size_t)batch*OBS_WIDTH), legal(batch), actions(batch), rowSlot(batch),
+        runSeed(seed) {}
+
+    void deal(int slot, int handNumber) {
+        HandRng g(runSeed, (uint64_t)handNumber);
+        lockstepDeal(slots[slot], handNumber, g);
+    }
+
+    // Play numHands hands, querying policy once per lockstep round.
+    LockstepStats run(int numHands, const BatchPolicy& policy, const CanonTable& table) {
+        LockstepStats stats;
+        int nextHand = 1;
+        vector<bool> active(batchSize, false);
+        for(int s=0; s<batchSize && nextHand<=numHands; ++s) {
+            deal(s, nextHand++);
+            active[s] = true;
         }
-        } else {
-            if (folded == false){
-                if(firstPlayerChips > secondPlayerChips){
-                    cout << "secondplayer folded turn" << " firstplayer wins: " << secondPlayerChips << "\n";
-                } else{
-                    cout << "firstplayer folded turn" << " second player wins: " << firstPlayerChips << "\n";
+        while(true) {
+            // gather: every hand in flight is waiting for exactly one decision
+            int rows = 0;
+            for(int s=0;s<batchSize;++s) {
+                if(!active[s]) continue;
+                lockstepEncode(slots[s], &obs[(size_t)rows*OBS_WIDTH]);
+                legal[rows] = (uint8_t)legalMask(slots[s].st);
+                rowSlot[rows] = s;
+                ++rows;
+            }
+            if(rows == 0) break;
+            policy(obs.data(), legal.data(), rows, actions.data());
+            ++stats.batches;
+            stats.decisions += rows;
+
+            // scatter
+            for(int r=0;r<rows;++r) {
+                int s = rowSlot[r];
+                Action a = actions[r];
+                // an illegal choice is replaced by the first legal action
+                if(!((legal[r] >> a) & 1)) a = (Action)__builtin_ctz(legal[r]);
+                if(onDecision) onDecision(s, &obs[(size_t)r*OBS_WIDTH], a);
+                lockstepApply(slots[s], a, table);
+                if(slots[s].done) {
+                    if(onHandDone) onHandDone(s, slots[s]);
+                    ++stats.hands;
+                    stats.p1Net += slots[s].result;
+                    if(nextHand <= numHands) deal(s, nextHand++);
+                    else active[s] = false;
                 }
-                folded = true;
             }
         }
+        return stats;
+    }
+};
+
+// Uniform random choice among legal actions, standing in for a model.
+void randomBatchPolicy(mt19937& g, const uint8_t* legal, int batch, Action* out) {
+    for(int i=0;i<batch;++i) {
+        Action buf[NUM_ACTIONS];
+        int n = 0;
+        for(int a=0;a<NUM_ACTIONS;++a) if((legal[i] >> a) & 1) buf[n++] = (Action)a;
+        uniform_int_distribution<int> dist(0, n-1);
+        out[i] = buf[dist(g)];
+    }
+}
+
+// Mode "batch": play hands in lockstep with the random policy and report throughput.
+int runBatchMode(int numHands, int batchSize, const CanonTable& table) {
+    cout << "Lockstep run: " << numHands << " hands, batch size " << batchSize << "\n";
+    LockstepRunner runner(batchSize);
+    auto t0 = chrono::steady_clock::now();
+    LockstepStats st = runner.run(numHands,
+        [](const int32_t*, const uint8_t* legal, int batch, Action* out) {
+            randomBatchPolicy(rng, legal, batch, out);
+        }, table);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << "Hands: " << st.hands << "  Decisions: " << st.decisions
+         << "  Policy calls: " << st.batches
+         << "  Avg batch: " << (st.batches ? (double)st.decisions / st.batches : 0.0) << "\n";
+    cout << "Player 1 net: " << st.p1Net << "\n";
+    cout << "Time: " << secs << " s  (" << (secs > 0 ? st.decisions / secs : 0.0) << " decisions/s)\n";
+    return 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION H — Feature encoding for bots and learning pipelines
+   Turns an observation row (Section G layout) into a fixed-width
+   numeric vector:
+     - one-hot hole cards and visible board (52 + 52, by cardIndex)
+     - one-hot street
+     - one-hot bet sequence: 4 streets x 6 action slots x NUM_ACTIONS
+     - pot, own/opponent chips, amount to call, raises left
+   Rows are FEAT_WIDTH wide (a multiple of 64 bytes for both float and
+   int8), the caller owns the memory and nothing is allocated, so a
+   batch can be written straight into a model's input tensor.
+   ------------------------------------------------------------------ */
+
+const int STREET_ACTION_SLOTS = 6;  // check, bet, raise x3, call
+
+enum FeatField {
+    FEAT_HOLE       = 0,                    // 52
+    FEAT_BOARD      = 52,                   // 52
+    FEAT_STREET     = 104,                  // 4
+    FEAT_HISTORY    = 108,                  // 4 * STREET_ACTION_SLOTS * NUM_ACTIONS = 120
+    FEAT_POT        = 228,
+    FEAT_MY_CHIPS   = 229,
+    FEAT_OPP_CHIPS  = 230,
+    FEAT_TO_CALL    = 231,
+    FEAT_RAISES_LEFT= 232,
+    FEAT_USED       = 233,
+    FEAT_WIDTH      = 256                   // padded
+};
+
+// Chip amounts are divided by this before encoding (larger than any pot we produce).
+const float FEAT_CHIP_SCALE = 400.0f;
+
+// Per-element conversions: float keeps the scaled value, int8 maps [0,1] to [0,127].
+inline void featSet(float* out, int i, float v) { out[i] = v; }
+inline void featSet(int8_t* out, int i, float v) {
+    float q = v * 127.0f;
+    out[i] = (int8_t)(q < 0 ? 0 : (q > 127.0f ? 127 : (int)(q + 0.5f)));
+}
+
+// Encode one observation row into out[0..FEAT_WIDTH). T is float or int8_t.
+template<typename T>
+void encodeFeatures(const int32_t* obs, T* out) {
+    memset(out, 0, sizeof(T) * FEAT_WIDTH);
+    featSet(out, FEAT_HOLE + obs[OBS_HOLE], 1.0f);
+    featSet(out, FEAT_HOLE + obs[OBS_HOLE + 1], 1.0f);
+    for(int i=0;i<5;++i)
+        if(obs[OBS_BOARD + i] >= 0) featSet(out, FEAT_BOARD + obs[OBS_BOARD + i], 1.0f);
+    int street = obs[OBS_STREET];
+    featSet(out, FEAT_STREET + street, 1.0f);
+
+    // bet sequence: slot = position of the action within its street
+    int slot = 0, prevStreet = 0, raisesThisStreet = 0;
+    int n = obs[OBS_NUM_ACTIONS];
+    for(int i=0;i<n;++i) {
+        int code = obs[OBS_HISTORY + i] - 1;
+        int s = code / NUM_ACTIONS, a = code % NUM_ACTIONS;
+        if(s != prevStreet) { prevStreet = s; slot = 0; }
+        if(slot < STREET_ACTION_SLOTS)
+            featSet(out, FEAT_HISTORY + (s*STREET_ACTION_SLOTS + slot)*NUM_ACTIONS + a, 1.0f);
+        ++slot;
+        if(s == street && (a == A_BET || a == A_RAISE)) ++raisesThisStreet;
+    }
+
+    int my = obs[OBS_MY_CHIPS], opp = obs[OBS_OPP_CHIPS];
+    featSet(out, FEAT_POT, obs[OBS_POT] / FEAT_CHIP_SCALE);
+    featSet(out, FEAT_MY_CHIPS, my / FEAT_CHIP_SCALE);
+    featSet(out, FEAT_OPP_CHIPS, opp / FEAT_CHIP_SCALE);
+    featSet(out, FEAT_TO_CALL, (opp > my ? opp - my : 0) / FEAT_CHIP_SCALE);
+    featSet(out, FEAT_RAISES_LEFT, (float)max(0, MAX_RAISES - raisesThisStreet) / MAX_RAISES);
+}
+
+// Encode batch rows of obs (batch x OBS_WIDTH) into out (batch x FEAT_WIDTH).
+template<typename T>
+void encodeFeatureBatch(const int32_t* obs, int batch, T* out) {
+    for(int i=0;i<batch;++i)
+        encodeFeatures(obs + (size_t)i*OBS_WIDTH, out + (size_t)i*FEAT_WIDTH);
+}
+
+// Build an observation row from main-style state: gameState totals for the
+// hand so far (pot and chips of both players), the player to act (1 or 2),
+// hole/board cards as encodeCard values and the Section G history codes.
+void observationFromGameState(const gameState& gs, int player, int street,
+                              const int hole[2], const int* board,
+                              const int* history, int numActions, int32_t* row) {
+    row[OBS_PLAYER] = player;
+    row[OBS_STREET] = street;
+    row[OBS_HOLE] = cardIndex(hole[0]);
+    row[OBS_HOLE + 1] = cardIndex(hole[1]);
+    for(int i=0;i<5;++i) row[OBS_BOARD + i] = (i < BOARD_VISIBLE[street] ? cardIndex(board[i]) : -1);
+    row[OBS_POT] = gs.pot;
+    row[OBS_MY_CHIPS] = (player == 1 ? gs.firstPlayerChips : gs.secondPlayerChips);
+    row[OBS_OPP_CHIPS] = (player == 1 ? gs.secondPlayerChips : gs.firstPlayerChips);
+    int n = min(numActions, MAX_HAND_ACTIONS);
+    row[OBS_NUM_ACTIONS] = n;
+    for(int i=0;i<MAX_HAND_ACTIONS;++i) row[OBS_HISTORY + i] = (i < n ? history[i] : 0);
+}
+
+// Mode "encode": encode a pool of realistic observations repeatedly and
+// report encodings/sec for float and int8 outputs.
+int runEncodeBench(int numEncodings, const CanonTable& table) {
+    const int POOL = 4096;
+    vector<int32_t> obs((size_t)POOL*OBS_WIDTH);
+    // sample decision points by playing random hands a random number of steps
+    for(int i=0;i<POOL;++i) {
+        LockstepHand h;
+        HandRng g(rng(), (uint64_t)i + 1);
+        lockstepDeal(h, i + 1, g);
+        uniform_int_distribution<int> stepsDist(0, 8);
+        int steps = stepsDist(rng);
+        for(int k=0;k<steps;++k) {
+            Action buf[3];
+            int n = legalActions(h.st, buf);
+            uniform_int_distribution<int> pick(0, n-1);
+            LockstepHand next = h;
+            lockstepApply(next, buf[pick(rng)], table);
+            if(next.done) break;
+            h = next;
+        }
+        lockstepEncode(h, &obs[(size_t)i*OBS_WIDTH]);
+    }
+
+    int rounds = max(1, numEncodings / POOL);
+    vector<float> outF((size_t)POOL*FEAT_WIDTH);
+    vector<int8_t> outQ((size_t)POOL*FEAT_WIDTH);
+    double checksum = 0;
+
+    auto t0 = chrono::steady_clock::now();
+    for(int r=0;r<rounds;++r) {
+        encodeFeatureBatch(obs.data(), POOL, outF.data());
+        checksum += outF[(size_t)(r % POOL)*FEAT_WIDTH + FEAT_POT];
+    }
+    double secsF = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    t0 = chrono::steady_clock::now();
+    for(int r=0;r<rounds;++r) {
+        encodeFeatureBatch(obs.data(), POOL, outQ.data());
+        checksum += outQ[(size_t)(r % POOL)*FEAT_WIDTH + FEAT_POT];
+    }
+    double secsQ = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    double total = (double)rounds * POOL;
+    cout << "Feature width: " << FEAT_WIDTH << " (" << FEAT_USED << " used)\n";
+    cout << "float: " << total / secsF << " encodings/s\n";
+    cout << "int8:  " << total / secsQ << " encodings/s\n";
+    cout << "(checksum " << checksum << ")\n";
+    return 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION I — Self-play data generation
+   One worker per core plays policy-vs-policy hands through its own
+   LockstepRunner and streams (observation, action, reward) records to
+   its own shard file. Each shard has two fixed-size buffers: the worker
+   fills one while a writer thread flushes the other, so disk I/O
+   overlaps play and memory stays bounded at 2 buffers per shard.
+   ------------------------------------------------------------------ */
+
+// On-disk record (little-endian int32s). reward = chips won by the
+// acting player over the whole hand (negative = lost).
+struct SelfPlayRecord {
+    int32_t obs[OBS_WIDTH];
+    int32_t action;
+    int32_t reward;
+};
+
+// Double-buffered append-only file writer.
+struct ShardWriter {
+    FILE* f = nullptr;
+    vector<char> buf[2];
+    size_t fill = 0;            // bytes used in buf[active]
+    int active = 0;
+    bool pending[2] = {false, false};   // buffer handed to the writer thread
+    size_t pendingSize[2] = {0, 0};
+    bool stop = false;
+    bool failed = false;        // a write or the close failed; later buffers are dropped
+    long long bytesWritten = 0;
+    mutex m;
+    condition_variable cv;
+    thread io;
+
+    bool open(const string& path, size_t bufferBytes) {
+        f = fopen(path.c_str(), "wb");
+        if(!f) return false;
+        buf[0].resize(bufferBytes);
+        buf[1].resize(bufferBytes);
+        io = thread([this]{ ioLoop(); });
+        return true;
+    }
+
+    void write(const void* data, size_t n) {
+        const char* p = (const char*)data;
+        while(n > 0) {
+            size_t take = min(n, buf[active].size() - fill);
+            memcpy(buf[active].data() + fill, p, take);
+            fill += take; p += take; n -= take;
+            if(fill == buf[active].size()) submit();
+        }
+    }
+
+    // Hand the active buffer to the writer thread and wait until the other one is free.
+    void submit() {
+        unique_lock<mutex> lk(m);
+        pending[active] = true;
+        pendingSize[active] = fill;
+        cv.notify_all();
+        active ^= 1;
+        cv.wait(lk, [this]{ return !pending[active]; });
+        fill = 0;
+    }
+
+    void ioLoop() {
+        int next = 0;
+        unique_lock<mutex> lk(m);
+        while(true) {
+            cv.wait(lk, [&]{ return pending[next] || stop; });
+            if(!pending[next]) break;   // stop requested and nothing left
+            size_t n = pendingSize[next];
+            bool skip = failed;
+            lk.unlock();
+            size_t done = skip ? 0 : fwrite(buf[next].data(), 1, n, f);
+            lk.lock();
+            bytesWritten += done;
+            if(done != n) failed = true;
+            pending[next] = false;
+            cv.notify_all();
+            next ^= 1;
+        }
+    }
+
+    // Flush, stop the writer thread and close the file. Returns false if
+    // any write or the close failed, i.e. the shard is incomplete.
+    bool close() {
+        if(!f) return !failed;
+        if(fill > 0) submit();
+        {
+            lock_guard<mutex> lk(m);
+            stop = true;
+        }
+        cv.notify_all();
+        io.join();
+        if(fclose(f) != 0) failed = true;
+        f = nullptr;
+        return !failed;
+    }
+};
+
+struct SelfPlayStats {
+    long long hands = 0;
+    long long records = 0;
+    long long bytes = 0;
+};
+
+// Play numHands hands and stream their records to writer.
+void selfPlayWorker(int numHands, int batchSize, uint32_t seed, const CanonTable& table,
+                    ShardWriter& writer, SelfPlayStats& out) {
+    LockstepRunner runner(batchSize, seed);
+    mt19937 policyRng(seed ^ 0x9e3779b9u);
+    // decisions of the hand currently in each slot, emitted when it ends
+    vector<SelfPlayRecord> pending((size_t)batchSize * MAX_HAND_ACTIONS);
+    vector<int> pendingCount(batchSize, 0);
+    long long records = 0;
+
+    runner.onDecision = [&](int slot, const int32_t* obs, Action a) {
+        int& n = pendingCount[slot];
+        if(n >= MAX_HAND_ACTIONS) return;
+        SelfPlayRecord& rec = pending[(size_t)slot*MAX_HAND_ACTIONS + n++];
+        memcpy(rec.obs, obs, sizeof(rec.obs));
+        rec.action = a;
+    };
+    runner.onHandDone = [&](int slot, const LockstepHand& h) {
+        SelfPlayRecord* recs = &pending[(size_t)slot*MAX_HAND_ACTIONS];
+        for(int i=0;i<pendingCount[slot];++i) {
+            recs[i].reward = (recs[i].obs[OBS_PLAYER] == 1 ? h.result : -h.result);
+            writer.write(&recs[i], sizeof(SelfPlayRecord));
+        }
+        records += pendingCount[slot];
+        pendingCount[slot] = 0;
+    };
+
+    // Both seats use the same stand-in policy; a model would read OBS_PLAYER
+    // to route rows to the policy playing that seat.
+    LockstepStats st = runner.run(numHands,
+        [&](const int32_t*, const uint8_t* legal, int batch, Action* acts) {
+            randomBatchPolicy(policyRng, legal, batch, acts);
+        }, table);
+    out.hands = st.hands;
+    out.records = records;
+}
+
+// Mode "selfplay": run on all cores, one shard per worker (<prefix>-NNN.bin).
+int runSelfPlay(int numHands, const string& prefix, const CanonTable& table) {
+    const int BATCH = 256;
+    const size_t BUFFER_BYTES = 4 << 20;
+    int workers = max(1u, thread::hardware_concurrency());
+    cout << "Self-play: " << numHands << " hands on " << workers << " workers, "
+         << sizeof(SelfPlayRecord) << " bytes/record\n";
+
+    vector<ShardWriter> writers(workers);
+    for(int w=0;w<workers;++w) {
+        char name[32];
+        snprintf(name, sizeof(name), "-%03d.bin", w);
+        if(!writers[w].open(prefix + name, BUFFER_BYTES)) {
+            cerr << "Cannot open " << prefix + name << " for writing\n";
+            for(int k=0;k<w;++k) writers[k].close();
+            return 1;
+        }
+    }
+
+    vector<SelfPlayStats> stats(workers);
+    vector<char> closed(workers, 0);
+    vector<thread> threads;
+    random_device seeder;
+    auto t0 = chrono::steady_clock::now();
+    for(int w=0;w<workers;++w) {
+        int share = numHands / workers + (w < numHands % workers ? 1 : 0);
+        uint32_t seed = seeder();
+        threads.emplace_back([&, w, share, seed]{
+            selfPlayWorker(share, BATCH, seed, table, writers[w], stats[w]);
+            closed[w] = writers[w].close();
+        });
+    }
+    for(auto& t : threads) t.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    bool ok = true;
+    for(int w=0;w<workers;++w) if(!closed[w]) {
+        char name[32];
+        snprintf(name, sizeof(name), "-%03d.bin", w);
+        cerr << "Write to " << prefix + name << " failed after " << writers[w].bytesWritten << " bytes\n";
+        ok = false;
+    }
+    if(!ok) return 1;
+
+    SelfPlayStats total;
+    for(int w=0;w<workers;++w) {
+        total.hands += stats[w].hands;
+        total.records += stats[w].records;
+        total.bytes += writers[w].bytesWritten;
+    }
+    cout << "Hands: " << total.hands << "  Records: " << total.records
+         << "  Bytes: " << total.bytes << "\n";
+    cout << "Time: " << secs << " s  (" << total.records / secs << " records/s, "
+         << total.bytes / secs / (1 << 20) << " MB/s)\n";
+    return 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION J — Best response, exploitability and re-solving (heads-up limit)
+   The betting tree is generated from the same street rules as
+   playStreetLog (streetStart/legalActions/streetApply). A best
+   response walks the public tree once per chance outcome and carries
+   1326-wide vectors (one entry per pair of hole cards):
+     - the opponent's reach probabilities going down
+     - the best responder's counterfactual values coming back up
+   Terminal values use card-removal aware sums: fold nodes need the
+   opponent reach that does not share a card with each hand, and
+   showdowns sweep the hands in strength order with prefix sums, so a
+   showdown costs O(1326) instead of O(1326^2).
+   The root must be on the flop or later: a preflop root would have to
+   enumerate all 22100 flops.
+   The re-solver at the end of the section runs CFR+ on the same
+   vectors for turn and river spots reached in play.
+   ------------------------------------------------------------------ */
+
+const int NUM_COMBOS = 1326;
+
+// All two-card combos as card indices (0..51), and the reverse map.
+struct ComboTable {
+    int cards[NUM_COMBOS][2];
+    int index[52][52];
+    int encoded[52];            // cardIndex -> encodeCard value
+
+    ComboTable() {
+        int n = 0;
+        for(int a=0;a<52;++a) {
+            encoded[a] = encodeCard(a % 13 + 2, a / 13);
+            index[a][a] = -1;
+            for(int b=a+1;b<52;++b) {
+                cards[n][0] = a; cards[n][1] = b;
+                index[a][b] = index[b][a] = n;
+                ++n;
+            }
+        }
+    }
+};
+static const ComboTable COMBOS;
+
+enum NodeType { NODE_DECISION, NODE_FOLD, NODE_SHOWDOWN, NODE_CHANCE };
+
+struct BettingNode {
+    NodeType type;
+    int street;
+    StreetState st;             // decision: state before the action
+    int player;                 // decision: player to act; fold: the folder
+    int chips[2];               // chips put in by player 1/2 when the node is reached
+    HistoryKey history;         // betting that leads to the node
+    int numChildren;
+    Action actions[3];
+    int children[3];            // chance: children[0] is the next street's first node
+};
+
+// Public betting tree from the start of rootStreet. The chance nodes between
+// streets have a single child: the betting that follows does not depend on
+// which card comes, so the same subtree is reused for every card.
+struct BettingTree {
+    vector<BettingNode> nodes;
+    int preflopOpener, postflopOpener;
+
+    // chips1/chips2: what each player has put in before rootStreet.
+    // rootHistory is the betting before rootStreet (limped when not known).
+    void build(int rootStreet, int chips1, int chips2, int preflopFirst) {
+        build(rootStreet, chips1, chips2, preflopFirst, historyLimpedTo(rootStreet));
+    }
+
+    void build(int rootStreet, int chips1, int chips2, int preflopFirst, HistoryKey rootHistory) {
+        nodes.clear();
+        preflopOpener = preflopFirst;
+        postflopOpener = (preflopFirst == 1 ? 2 : 1);
+        addStreet(rootStreet, chips1, chips2, rootHistory);
+    }
+
+    int addStreet(int street, int base1, int base2, HistoryKey h) {
+        StreetState st;
+        streetStart(st, street == 0, street == 0 ? preflopOpener : postflopOpener);
+        return addDecision(street, st, base1, base2, h);
+    }
+
+    int addDecision(int street, const StreetState& st, int base1, int base2, HistoryKey h) {
+        int id = (int)nodes.size();
+        BettingNode node;
+        node.type = NODE_DECISION;
+        node.street = street;
+        node.st = st;
+        node.history = h;
+        node.player = st.current;
+        node.chips[0] = base1 + st.firstPlayerChipsOnPot;
+        node.chips[1] = base2 + st.secondPlayerChipsOnPot;
+        node.numChildren = legalActions(st, node.actions);
+        nodes.push_back(node);
+        for(int k=0;k<node.numChildren;++k) {
+            StreetState nx = st;
+            streetApply(nx, node.actions[k]);
+            HistoryKey nh = historyAppend(h, node.actions[k]);
+            int child;
+            if(!nx.finished) {
+                child = addDecision(street, nx, base1, base2, nh);
+            } else {
+                BettingNode term;
+                term.street = street;
+                term.st = nx;
+                term.history = nh;
+                term.player = nx.current;
+                term.chips[0] = base1 + nx.firstPlayerChipsOnPot;
+                term.chips[1] = base2 + nx.secondPlayerChipsOnPot;
+                term.numChildren = 0;
+                if(nx.lastAction == A_FOLD) term.type = NODE_FOLD;
+                else if(street == 3) term.type = NODE_SHOWDOWN;
+                else term.type = NODE_CHANCE;
+                child = (int)nodes.size();
+                nodes.push_back(term);
+                if(term.type == NODE_CHANCE) {
+                    int next = addStreet(street + 1, term.chips[0], term.chips[1], nh);
+                    nodes[child].numChildren = 1;
+                    nodes[child].children[0] = next;
+                }
+            }
+            nodes[id].children[k] = child;
+        }
+        return id;
+    }
+};
+
+// Strategy of the player acting at a decision node for every combo:
+// probs[k*NUM_COMBOS + h] = probability of node.actions[k] holding combo h.
+// board holds numBoard encoded cards.
+typedef function<void(const BettingTree& tree, int node, const int* board, int numBoard, float* probs)> RangeStrategy;
+
+// The random policy of pickRandom: every legal action equally likely.
+void uniformRangeStrategy(const BettingTree& tree, int node, const int*, int, float* probs) {
+    int n = tree.nodes[node].numChildren;
+    fill(probs, probs + (size_t)n*NUM_COMBOS, 1.0f / n);
+}
+
+// Showdown ranking of all combos for one 5-card board.
+struct BoardRanking {
+    vector<int> order;          // valid combos, weakest first
+    vector<int> strength;       // canonical index per combo (larger = weaker)
+};
+
+void rankBoard(const FastEvaluator& eval, const int* board, BoardRanking& out) {
+    uint64_t dead = 0;
+    for(int i=0;i<5;++i) dead |= 1ULL << cardIndex(board[i]);
+    out.strength.assign(NUM_COMBOS, 0);
+    out.order.clear();
+    int cards[7];
+    for(int i=0;i<5;++i) cards[i+2] = board[i];
+    for(int h=0;h<NUM_COMBOS;++h) {
+        int a = COMBOS.cards[h][0], b = COMBOS.cards[h][1];
+        if((dead >> a) & 1 || (dead >> b) & 1) continue;
+        cards[0] = COMBOS.encoded[a];
+        cards[1] = COMBOS.encoded[b];
+        out.strength[h] = eval.eval7(cards);
+        out.order.push_back(h);
+    }
+    auto& s = out.strength;
+    sort(out.order.begin(), out.order.end(), [&](int x, int y){ return s[x] > s[y]; });
+}
+
+// Opponent reach not sharing a card with each combo: total - per-card sums
+// (+ r[h] because combo h itself was subtracted twice).
+void nonBlockedReach(const float* reach, float* out) {
+    double total = 0;
+    double perCard[52] = {0};
+    for(int h=0;h<NUM_COMBOS;++h) {
+        total += reach[h];
+        perCard[COMBOS.cards[h][0]] += reach[h];
+        perCard[COMBOS.cards[h][1]] += reach[h];
+    }
+    for(int h=0;h<NUM_COMBOS;++h)
+        out[h] = (float)(total - perCard[COMBOS.cards[h][0]] - perCard[COMBOS.cards[h][1]] + reach[h]);
+}
+
+// Per combo: (opponent reach of weaker hands) * winAmount - (reach of stronger hands) * loseAmount
+void showdownValues(const BoardRanking& rk, const float* reach, double winAmount, double loseAmount, float* value) {
+    const vector<int>& ord = rk.order;
+    const vector<int>& s = rk.strength;
+    int n = (int)ord.size();
+    double sum = 0, perCard[52];
+    // weaker hands: sweep from the weakest group upwards
+    fill(perCard, perCard + 52, 0.0);
+    for(int i=0;i<n;) {
+        int j = i;
+        while(j < n && s[ord[j]] == s[ord[i]]) ++j;
+        for(int k=i;k<j;++k) {
+            int h = ord[k];
+            value[h] = (float)(winAmount * (sum - perCard[COMBOS.cards[h][0]] - perCard[COMBOS.cards[h][1]]));
+        }
+        for(int k=i;k<j;++k) {
+            int h = ord[k];
+            sum += reach[h];
+            perCard[COMBOS.cards[h][0]] += reach[h];
+            perCard[COMBOS.cards[h][1]] += reach[h];
+        }
+        i = j;
+    }
+    // stronger hands: sweep from the strongest group downwards
+    sum = 0;
+    fill(perCard, perCard + 52, 0.0);
+    for(int i=n-1;i>=0;) {
+        int j = i;
+        while(j >= 0 && s[ord[j]] == s[ord[i]]) --j;
+        for(int k=i;k>j;--k) {
+            int h = ord[k];
+            value[h] -= (float)(loseAmount * (sum - perCard[COMBOS.cards[h][0]] - perCard[COMBOS.cards[h][1]]));
+        }
+        for(int k=i;k>j;--k) {
+            int h = ord[k];
+            sum += reach[h];
+            perCard[COMBOS.cards[h][0]] += reach[h];
+            perCard[COMBOS.cards[h][1]] += reach[h];
+        }
+        i = j;
+    }
+}
+
+struct BestResponse {
+    const BettingTree& tree;
+    const FastEvaluator& eval;
+    const RangeStrategy& strategy;
+    int brPlayer;               // 1 or 2
+    int board[5];
+    int numBoard;
+    // rankings are shared by every showdown under the same river card set
+    unordered_map<uint64_t, BoardRanking> rankings;
+    const BoardRanking* river = nullptr;
+
+    BestResponse(const BettingTree& t, const FastEvaluator& e, const RangeStrategy& s, int player)
+        : tree(t), eval(e), strategy(s), brPlayer(player), numBoard(0) {}
+
+    void setRiverRanking() {
+        uint64_t key = 0;
+        for(int i=0;i<5;++i) key |= 1ULL << cardIndex(board[i]);
+        auto it = rankings.find(key);
+        if(it == rankings.end()) {
+            it = rankings.emplace(key, BoardRanking()).first;
+            rankBoard(eval, board, it->second);
+        }
+        river = &it->second;
+    }
+
+    // value[h]: expected chips for the best responder holding h, weighted by
+    // the opponent reach passed in (counterfactual value).
+    void traverse(int id, const float* oppReach, float* value) {
+        const BettingNode& node = tree.nodes[id];
+        int me = brPlayer - 1, opp = 1 - me;
+        if(node.type == NODE_FOLD) {
+            double payoff = (node.player == brPlayer ? -node.chips[me] : node.chips[opp]);
+            nonBlockedReach(oppReach, value);
+            for(int h=0;h<NUM_COMBOS;++h) value[h] = (float)(value[h] * payoff);
+            return;
+        }
+        if(node.type == NODE_SHOWDOWN) {
+            showdownValues(*river, oppReach, node.chips[opp], node.chips[me], value);
+            return;
+        }
+        vector<float> child(NUM_COMBOS);
+        if(node.type == NODE_CHANCE) {
+            fill(value, value + NUM_COMBOS, 0.0f);
+            uint64_t dead = 0;
+            for(int i=0;i<numBoard;++i) dead |= 1ULL << cardIndex(board[i]);
+            vector<float> reach(NUM_COMBOS);
+            for(int c=0;c<52;++c) {
+                if((dead >> c) & 1) continue;
+                for(int h=0;h<NUM_COMBOS;++h)
+                    reach[h] = (COMBOS.cards[h][0] == c || COMBOS.cards[h][1] == c) ? 0.0f : oppReach[h];
+                board[numBoard++] = COMBOS.encoded[c];
+                if(numBoard == 5) setRiverRanking();
+                traverse(node.children[0], reach.data(), child.data());
+                --numBoard;
+                for(int h=0;h<NUM_COMBOS;++h)
+                    if(COMBOS.cards[h][0] != c && COMBOS.cards[h][1] != c) value[h] += child[h];
+            }
+            // each card is equally likely given both players' hole cards
+            float w = 1.0f / (52 - numBoard - 4);
+            for(int h=0;h<NUM_COMBOS;++h) value[h] *= w;
+            return;
+        }
+        // decision node
+        if(node.player == brPlayer) {
+            for(int k=0;k<node.numChildren;++k) {
+                traverse(node.children[k], oppReach, child.data());
+                for(int h=0;h<NUM_COMBOS;++h)
+                    value[h] = (k == 0 ? child[h] : max(value[h], child[h]));
+            }
+            return;
+        }
+        vector<float> probs((size_t)node.numChildren * NUM_COMBOS);
+        strategy(tree, id, board, numBoard, probs.data());
+        vector<float> reach(NUM_COMBOS);
+        fill(value, value + NUM_COMBOS, 0.0f);
+        for(int k=0;k<node.numChildren;++k) {
+            const float* p = &probs[(size_t)k*NUM_COMBOS];
+            for(int h=0;h<NUM_COMBOS;++h) reach[h] = oppReach[h] * p[h];
+            traverse(node.children[k], reach.data(), child.data());
+            for(int h=0;h<NUM_COMBOS;++h) value[h] += child[h];
+        }
+    }
+};
+
+// Zero the weight of combos that use a board card.
+void removeBoardCombos(const int* board, int numBoard, float* range) {
+    for(int i=0;i<numBoard;++i) {
+        int c = cardIndex(board[i]);
+        for(int h=0;h<NUM_COMBOS;++h)
+            if(COMBOS.cards[h][0] == c || COMBOS.cards[h][1] == c) range[h] = 0.0f;
+    }
+}
+
+// Expected chips per hand for player brPlayer best-responding to strategy,
+// when player i's hole cards follow ranges[i-1] (unnormalized weights)
+// at rootNode. Chips already in the pot count as lost to the pot.
+double bestResponseValue(const BettingTree& tree, const FastEvaluator& eval, const RangeStrategy& strategy,
+                         int brPlayer, const int* board, int numBoard, const vector<float> ranges[2],
+                         int rootNode = 0) {
+    BestResponse br(tree, eval, strategy, brPlayer);
+    br.numBoard = numBoard;
+    for(int i=0;i<numBoard;++i) br.board[i] = board[i];
+    if(numBoard == 5) br.setRiverRanking();
+
+    vector<float> mine = ranges[brPlayer-1], opp = ranges[2-brPlayer];
+    removeBoardCombos(board, numBoard, mine.data());
+    removeBoardCombos(board, numBoard, opp.data());
+    vector<float> value(NUM_COMBOS), oppMass(NUM_COMBOS);
+    br.traverse(rootNode, opp.data(), value.data());
+    nonBlockedReach(opp.data(), oppMass.data());
+    double num = 0, den = 0;
+    for(int h=0;h<NUM_COMBOS;++h) {
+        num += (double)mine[h] * value[h];
+        den += (double)mine[h] * oppMass[h];
+    }
+    return den > 0 ? num / den : 0.0;
+}
+
+// Mode "br": exploitability of the random policy on a flop/turn/river board.
+// Usage: br [cards...]  (3-5 cards like "Ah Kd 7c"; default a random flop)
+int runBestResponse(const vector<string>& cardArgs, const CanonTable& table) {
+    vector<int> board;
+    for(const auto& a : cardArgs) {
+        int c = parseCard(a);
+        if(c < 0) { cerr << "Bad card: " << a << "\n"; return 1; }
+        board.push_back(c);
+    }
+    if(board.empty()) {
+        Deck deck;
+        deck.shuffle();
+        for(int i=0;i<3;++i) board.push_back(deck.deal());
+    }
+    if(board.size() < 3 || board.size() > 5) { cerr << "Need 3 to 5 board cards\n"; return 1; }
+
+    FastEvaluator eval;
+    eval.build(table);
+    BettingTree tree;
+    // both players limped preflop (20 each), player 1 opened preflop
+    int rootStreet = (int)board.size() - 2;
+    tree.build(rootStreet, 20, 20, 1);
+
+    cout << "Board:";
+    for(int c : board) cout << " " << cardToString(c);
+    cout << "\nRoot: " << STREET_NAMES[rootStreet] << ", public tree nodes: " << tree.nodes.size() << "\n";
+
+    vector<float> ranges[2] = { vector<float>(NUM_COMBOS, 1.0f), vector<float>(NUM_COMBOS, 1.0f) };
+    auto t0 = chrono::steady_clock::now();
+    double v1 = bestResponseValue(tree, eval, uniformRangeStrategy, 1, board.data(), (int)board.size(), ranges);
+    double v2 = bestResponseValue(tree, eval, uniformRangeStrategy, 2, board.data(), (int)board.size(), ranges);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    double expl = (v1 + v2) / 2;
+    cout << "Best response value, player 1: " << v1 << " chips/hand\n";
+    cout << "Best response value, player 2: " << v2 << " chips/hand\n";
+    cout << "Exploitability of random play: " << expl << " chips/hand ("
+         << expl / 20.0 * 1000.0 << " mbb/hand)\n";
+    cout << "Time: " << secs << " s\n";
+    return 0;
+}
+
+/* Subgame re-solving. Given a turn or river spot (board, chips put in
+   before the street, actions so far on the street and both ranges),
+   CFR+ runs on the remaining public tree until the time budget runs
+   out. Regrets and strategy sums are 1326-wide per decision node; nodes
+   after the turn->river chance node keep one set per river card. Work
+   is split across threads by river card (turn spots) or by the root's
+   actions (river spots), whose subtrees own disjoint storage. */
+
+// Run fn(0..n-1) on up to `threads` threads.
+void parallelFor(int n, int threads, const function<void(int)>& fn) {
+    threads = max(1, min(threads, n));
+    if(threads == 1) { for(int i=0;i<n;++i) fn(i); return; }
+    atomic<int> next(0);
+    vector<thread> pool;
+    for(int t=0;t<threads;++t)
+        pool.emplace_back([&]{ for(int i; (i = next++) < n; ) fn(i); });
+    for(auto& th : pool) th.join();
+}
+
+struct PublicState {
+    vector<int> board;              // 4 (turn) or 5 (river) encoded cards
+    HistoryKey prior = HISTORY_ROOT;    // betting before this street; HISTORY_ROOT if both limped
+    int preflopOpener = 1;
+    vector<Action> streetActions;   // actions taken so far on this street
+    vector<float> ranges[2] = { vector<float>(NUM_COMBOS, 1.0f), vector<float>(NUM_COMBOS, 1.0f) };
+
+    int street() const { return (int)board.size() - 2; }
+    HistoryKey priorHistory() const { return prior == HISTORY_ROOT ? historyLimpedTo(street()) : prior; }
+    // The prior betting must end exactly at the start of this street.
+    bool priorValid() const {
+        HistoryKey h = priorHistory();
+        return historyStreet(h) == street() && historyNode(h, street()) == 0 && !historyTerminal(h);
+    }
+    // Build the tree from this street, with the chips and infoset keys of the prior betting.
+    void buildTree(BettingTree& tree) const {
+        HistoryKey h = priorHistory();
+        int chips[2];
+        historyChips(h, preflopOpener, chips);
+        tree.build(street(), chips[0], chips[1], preflopOpener, h);
+    }
+};
+
+struct ResolveResult {
+    int root = -1;                  // tree node of the spot, -1 if the history is illegal
+    int player = 0;                 // player to act at the root
+    vector<float> strategy;         // average strategy at the root: [k][NUM_COMBOS]
+    int iterations = 0;
+    double exploitability = 0;      // chips/hand of the average strategy in the subgame
+};
+
+struct SubgameSolver {
+    BettingTree tree;
+    const FastEvaluator& eval;
+    int rootNode, rootStreet;
+    vector<int> rootBoard;
+    vector<vector<float>> regret, avg;  // per node: [slot][k][NUM_COMBOS]
+    unordered_map<uint64_t, BoardRanking> rankings;
+    int threads;
+
+    // Per-thread traversal state
+    struct Ctx {
+        int board[5];
+        int numBoard;
+        int slot;                   // river card for nodes after the chance node
+        const BoardRanking* river;
+    };
+
+    SubgameSolver(const FastEvaluator& e, int numThreads) : eval(e), threads(numThreads) {}
+
+    int slotsFor(int node) const { return tree.nodes[node].street > rootStreet ? 52 : 1; }
+
+    float* regretAt(int node, int slot) {
+        return &regret[node][(size_t)(slotsFor(node) > 1 ? slot : 0) * tree.nodes[node].numChildren * NUM_COMBOS];
+    }
+    float* avgAt(int node, int slot) {
+        return &avg[node][(size_t)(slotsFor(node) > 1 ? slot : 0) * tree.nodes[node].numChildren * NUM_COMBOS];
+    }
+
+    const BoardRanking* rankingFor(const int* board) {
+        uint64_t key = 0;
+        for(int i=0;i<5;++i) key |= 1ULL << cardIndex(board[i]);
+        auto it = rankings.find(key);
+        if(it == rankings.end()) {
+            it = rankings.emplace(key, BoardRanking()).first;
+            rankBoard(eval, board, it->second);
+        }
+        return &it->second;
+    }
+
+    // Regret matching+: positive regrets normalized, uniform if none.
+    static void currentStrategy(const float* r, int n, float* sigma) {
+        for(int h=0;h<NUM_COMBOS;++h) {
+            float sum = 0;
+            for(int k=0;k<n;++k) sum += max(r[(size_t)k*NUM_COMBOS + h], 0.0f);
+            for(int k=0;k<n;++k)
+                sigma[(size_t)k*NUM_COMBOS + h] = (sum > 0 ? max(r[(size_t)k*NUM_COMBOS + h], 0.0f) / sum : 1.0f / n);
+        }
+    }
+
+    bool setup(const PublicState& ps, ResolveResult& res) {
+        rootBoard = ps.board;
+        rootStreet = ps.street();
+        if(!ps.priorValid()) return false;
+        ps.buildTree(tree);
+        rootNode = 0;
+        for(Action a : ps.streetActions) {
+            const BettingNode& n = tree.nodes[rootNode];
+            int k = 0;
+            while(k < n.numChildren && n.actions[k] != a) ++k;
+            if(n.type != NODE_DECISION || k == n.numChildren) return false;
+            rootNode = n.children[k];
+        }
+        if(tree.nodes[rootNode].type != NODE_DECISION) return false;
+        regret.assign(tree.nodes.size(), vector<float>());
+        avg.assign(tree.nodes.size(), vector<float>());
+        for(size_t i=rootNode;i<tree.nodes.size();++i) {
+            if(tree.nodes[i].type != NODE_DECISION) continue;
+            size_t sz = (size_t)slotsFor((int)i) * tree.nodes[i].numChildren * NUM_COMBOS;
+            regret[i].assign(sz, 0.0f);
+            avg[i].assign(sz, 0.0f);
+        }
+        // every river board is ranked up front so threads only read the cache
+        if(rootStreet == 3) rankingFor(rootBoard.data());
+        else {
+            int b[5];
+            for(int i=0;i<4;++i) b[i] = rootBoard[i];
+            uint64_t dead = 0;
+            for(int i=0;i<4;++i) dead |= 1ULL << cardIndex(rootBoard[i]);
+            for(int c=0;c<52;++c) {
+                if((dead >> c) & 1) continue;
+                b[4] = COMBOS.encoded[c];
+                rankingFor(b);
+            }
+        }
+        res.root = rootNode;
+        res.player = tree.nodes[rootNode].player;
+        return true;
+    }
+
+    // Vector CFR+ for traverser trav: value[h] is trav's counterfactual value.
+    void cfr(Ctx& ctx, int id, int trav, const float* reachT, const float* reachO,
+             float weight, bool par, float* value) {
+        const BettingNode& node = tree.nodes[id];
+        int me = trav - 1, opp = 1 - me;
+        if(node.type == NODE_FOLD) {
+            double payoff = (node.player == trav ? -node.chips[me] : node.chips[opp]);
+            nonBlockedReach(reachO, value);
+            for(int h=0;h<NUM_COMBOS;++h) value[h] = (float)(value[h] * payoff);
+            return;
+        }
+        if(node.type == NODE_SHOWDOWN) {
+            showdownValues(*ctx.river, reachO, node.chips[opp], node.chips[me], value);
+            return;
+        }
+        if(node.type == NODE_CHANCE) {
+            uint64_t dead = 0;
+            for(int i=0;i<ctx.numBoard;++i) dead |= 1ULL << cardIndex(ctx.board[i]);
+            vector<int> cards;
+            for(int c=0;c<52;++c) if(!((dead >> c) & 1)) cards.push_back(c);
+            vector<vector<float>> childVals(cards.size(), vector<float>(NUM_COMBOS));
+            auto one = [&](int i) {
+                int c = cards[i];
+                Ctx sub = ctx;
+                sub.board[sub.numBoard++] = COMBOS.encoded[c];
+                sub.slot = c;
+                sub.river = rankingFor(sub.board);
+                vector<float> rt(NUM_COMBOS), ro(NUM_COMBOS);
+                for(int h=0;h<NUM_COMBOS;++h) {
+                    bool blocked = (COMBOS.cards[h][0] == c || COMBOS.cards[h][1] == c);
+                    rt[h] = blocked ? 0.0f : reachT[h];
+                    ro[h] = blocked ? 0.0f : reachO[h];
+                }
+                cfr(sub, node.children[0], trav, rt.data(), ro.data(), weight, false, childVals[i].data());
+                for(int h=0;h<NUM_COMBOS;++h)
+                    if(COMBOS.cards[h][0] == c || COMBOS.cards[h][1] == c) childVals[i][h] = 0.0f;
+            };
+            if(par) parallelFor((int)cards.size(), threads, one);
+            else for(int i=0;i<(int)cards.size();++i) one(i);
+            float w = 1.0f / (52 - ctx.numBoard - 4);
+            fill(value, value + NUM_COMBOS, 0.0f);
+            for(auto& cv : childVals)
+                for(int h=0;h<NUM_COMBOS;++h) value[h] += cv[h];
+            for(int h=0;h<NUM_COMBOS;++h) value[h] *= w;
+            return;
+        }
+
+        int n = node.numChildren;
+        float* R = regretAt(id, ctx.slot);
+        vector<float> sigma((size_t)n*NUM_COMBOS);
+        currentStrategy(R, n, sigma.data());
+        vector<vector<float>> childVals(n, vector<float>(NUM_COMBOS));
+        // only a river root fans out here; turn roots split at the chance node
+        bool split = par && rootStreet == 3;
+        auto one = [&](int k) {
+            const float* sk = &sigma[(size_t)k*NUM_COMBOS];
+            vector<float> reach(NUM_COMBOS);
+            if(node.player == trav) {
+                for(int h=0;h<NUM_COMBOS;++h) reach[h] = reachT[h] * sk[h];
+                cfr(ctx, node.children[k], trav, reach.data(), reachO, weight, par && !split, childVals[k].data());
+            } else {
+                for(int h=0;h<NUM_COMBOS;++h) reach[h] = reachO[h] * sk[h];
+                cfr(ctx, node.children[k], trav, reachT, reach.data(), weight, par && !split, childVals[k].data());
+            }
+        };
+        if(split) parallelFor(n, threads, one);
+        else for(int k=0;k<n;++k) one(k);
+
+        if(node.player != trav) {
+            fill(value, value + NUM_COMBOS, 0.0f);
+            for(int k=0;k<n;++k)
+                for(int h=0;h<NUM_COMBOS;++h) value[h] += childVals[k][h];
+            return;
+        }
+        float* S = avgAt(id, ctx.slot);
+        for(int h=0;h<NUM_COMBOS;++h) {
+            float v = 0;
+            for(int k=0;k<n;++k) v += sigma[(size_t)k*NUM_COMBOS + h] * childVals[k][h];
+            value[h] = v;
+        }
+        for(int k=0;k<n;++k) {
+            float* Rk = R + (size_t)k*NUM_COMBOS;
+            float* Sk = S + (size_t)k*NUM_COMBOS;
+            const float* sk = &sigma[(size_t)k*NUM_COMBOS];
+            for(int h=0;h<NUM_COMBOS;++h) {
+                Rk[h] = max(Rk[h] + childVals[k][h] - value[h], 0.0f);
+                Sk[h] += weight * reachT[h] * sk[h];
+            }
+        }
+    }
+
+    // Normalized average strategy at a node (uniform where never reached).
+    void averageStrategy(int node, int slot, float* probs) {
+        int n = tree.nodes[node].numChildren;
+        const float* S = avgAt(node, slot);
+        for(int h=0;h<NUM_COMBOS;++h) {
+            float sum = 0;
+            for(int k=0;k<n;++k) sum += S[(size_t)k*NUM_COMBOS + h];
+            for(int k=0;k<n;++k)
+                probs[(size_t)k*NUM_COMBOS + h] = (sum > 0 ? S[(size_t)k*NUM_COMBOS + h] / sum : 1.0f / n);
+        }
+    }
+};
+
+// Solve the spot in ps for up to budgetMs milliseconds.
+ResolveResult resolveSubgame(const PublicState& ps, const FastEvaluator& eval, int budgetMs, int threads) {
+    ResolveResult res;
+    if(ps.board.size() < 4 || ps.board.size() > 5) return res;
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds(budgetMs);
+    SubgameSolver solver(eval, threads);
+    if(!solver.setup(ps, res)) { res.root = -1; return res; }
+
+    vector<float> ranges[2] = { ps.ranges[0], ps.ranges[1] };
+    removeBoardCombos(ps.board.data(), (int)ps.board.size(), ranges[0].data());
+    removeBoardCombos(ps.board.data(), (int)ps.board.size(), ranges[1].data());
+    SubgameSolver::Ctx ctx;
+    ctx.numBoard = (int)ps.board.size();
+    for(int i=0;i<ctx.numBoard;++i) ctx.board[i] = ps.board[i];
+    ctx.slot = 0;
+    ctx.river = (ctx.numBoard == 5 ? solver.rankingFor(ctx.board) : nullptr);
+
+    vector<float> value(NUM_COMBOS);
+    // always run at least one iteration so there is a strategy to return
+    do {
+        ++res.iterations;
+        for(int trav=1; trav<=2; ++trav)
+            solver.cfr(ctx, solver.rootNode, trav, ranges[trav-1].data(), ranges[2-trav].data(),
+                       (float)res.iterations, true, value.data());
+    } while(chrono::steady_clock::now() < deadline);
+
+    int n = solver.tree.nodes[solver.rootNode].numChildren;
+    res.strategy.assign((size_t)n*NUM_COMBOS, 0.0f);
+    solver.averageStrategy(solver.rootNode, 0, res.strategy.data());
+
+    RangeStrategy avgStrategy = [&](const BettingTree& t, int node, const int* board, int numBoard, float* probs) {
+        int slot = (t.nodes[node].street > solver.rootStreet ? cardIndex(board[numBoard-1]) : 0);
+        solver.averageStrategy(node, slot, probs);
+    };
+    double v1 = bestResponseValue(solver.tree, eval, avgStrategy, 1, ps.board.data(), (int)ps.board.size(), ps.ranges, solver.rootNode);
+    double v2 = bestResponseValue(solver.tree, eval, avgStrategy, 2, ps.board.data(), (int)ps.board.size(), ps.ranges, solver.rootNode);
+    res.exploitability = (v1 + v2) / 2;
+    return res;
+}
+
+// Mode "resolve": re-solve a turn/river spot with uniform ranges.
+// Usage: resolve [ms] cards... [prior=a,b,...] [actions...]
+//   e.g. resolve 200 Ah Kd 7c 2s 9h prior=raise,call,bet,call,check,check check bet
+// prior= is the betting of the earlier streets (default: limped); the
+// other actions are those taken so far on the board's last street.
+int runResolve(const vector<string>& args, const CanonTable& table) {
+    PublicState ps;
+    int budget = 200;
+    size_t i = 0;
+    // only an all-digit token is the budget, so a board like 9h Kd 7c 2s keeps its first card
+    if(i < args.size() && !args[i].empty() && all_of(args[i].begin(), args[i].end(), ::isdigit)) budget = atoi(args[i++].c_str());
+    for(; i<args.size(); ++i) {
+        int c = parseCard(args[i]);
+        if(c >= 0) { ps.board.push_back(c); continue; }
+        if(args[i].compare(0, 6, "prior=") == 0) {
+            HistoryKey h = HISTORY_ROOT;
+            istringstream in(args[i].substr(6));
+            string word;
+            while(getline(in, word, ',')) {
+                int a = 0;
+                while(a < NUM_ACTIONS && actionStr((Action)a) != word) ++a;
+                if(a == NUM_ACTIONS || historyTerminal(h) || !((historyLegalMask(h) >> a) & 1)) {
+                    cerr << "Illegal prior action: " << word << "\n";
+                    return 1;
+                }
+                h = historyAppend(h, (Action)a);
+            }
+            ps.prior = h;
+            continue;
+        }
+        int a = 0;
+        while(a < NUM_ACTIONS && actionStr((Action)a) != args[i]) ++a;
+        if(a == NUM_ACTIONS) { cerr << "Not a card or action: " << args[i] << "\n"; return 1; }
+        ps.streetActions.push_back((Action)a);
+    }
+    if(ps.board.empty()) {
+        Deck deck;
+        deck.shuffle();
+        for(int k=0;k<5;++k) ps.board.push_back(deck.deal());
+    }
+    if(ps.board.size() < 4 || ps.board.size() > 5) { cerr << "Need 4 or 5 board cards\n"; return 1; }
+    if(!ps.priorValid()) { cerr << "Prior betting must end at the start of the " << STREET_NAMES[ps.street()] << "\n"; return 1; }
+
+    FastEvaluator eval;
+    eval.build(table);
+    int threads = max(1u, thread::hardware_concurrency());
+    cout << "Board:";
+    for(int c : ps.board) cout << " " << cardToString(c);
+    cout << "\nBudget: " << budget << " ms on " << threads << " threads\n";
+
+    auto t0 = chrono::steady_clock::now();
+    ResolveResult res = resolveSubgame(ps, eval, budget, threads);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    if(res.root < 0) { cerr << "Action history is not legal here\n"; return 1; }
+
+    BettingTree tree;
+    ps.buildTree(tree);
+    const BettingNode& root = tree.nodes[res.root];
+    cout << "Iterations: " << res.iterations << "  Time: " << secs << " s (incl. exploitability check)\n";
+    cout << "Exploitability: " << res.exploitability << " chips/hand ("
+         << res.exploitability / 20.0 * 1000.0 << " mbb/hand)\n";
+    // average over the acting player's range
+    vector<float> range = ps.ranges[res.player-1];
+    removeBoardCombos(ps.board.data(), (int)ps.board.size(), range.data());
+    double total = accumulate(range.begin(), range.end(), 0.0);
+    cout << "Player " << res.player << " strategy:";
+    for(int k=0;k<root.numChildren;++k) {
+        double p = 0;
+        for(int h=0;h<NUM_COMBOS;++h) p += range[h] * res.strategy[(size_t)k*NUM_COMBOS + h];
+        cout << "  " << actionStr(root.actions[k]) << " " << fixed << setprecision(3) << p / total;
+    }
+    cout << "\n";
+    return 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION K — Strategy table storage
+   Solver output for many information sets is written once and read
+   at play time. File layout (all little-endian):
+     header   magic, version, quantization bits, counts, offsets
+     blocks   compressed runs of BLOCK_INFOSETS quantized strategies
+     index    sorted (key, numActions) per infoset
+     blockTab (offset, compressed size, raw size) per block
+   Probabilities are stored as 8- or 16-bit integers and renormalized
+   when read. Blocks use a small LZ77 coder (no external libraries).
+   StrategyTable::open only maps the file and reads the header: index
+   pages and blocks are faulted in by the OS on first lookup, and the
+   last few decoded blocks are kept in a small cache.
+   ------------------------------------------------------------------ */
+
+const uint32_t STRAT_MAGIC = 0x54534b50;   // "PKST"
+const uint32_t STRAT_VERSION = 1;
+const int BLOCK_INFOSETS = 256;
+
+struct StratHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t quantBits;         // 8 or 16
+    uint32_t blockInfosets;
+    uint64_t numInfosets;
+    uint64_t numBlocks;
+    uint64_t indexOffset;
+    uint64_t blockTabOffset;
+};
+
+struct StratIndexEntry {
+    uint64_t key;
+    uint8_t numActions;
+    uint8_t pad[7];
+};
+
+struct StratBlockEntry {
+    uint64_t offset;
+    uint32_t compressedSize;
+    uint32_t rawSize;
+};
+
+// LZ77 byte coder: a sequence of [literal count][literals][match length][match offset],
+// counts as LEB128 varints, match length 0 meaning "no match" (end of input).
+void putVarint(vector<uint8_t>& out, uint32_t v) {
+    while(v >= 0x80) { out.push_back((uint8_t)(v | 0x80)); v >>= 7; }
+    out.push_back((uint8_t)v);
+}
+
+// False if the varint runs past end or does not fit 32 bits.
+bool getVarint(const uint8_t*& p, const uint8_t* end, uint32_t& v) {
+    v = 0;
+    for(int shift=0; shift<35; shift+=7) {
+        if(p == end) return false;
+        uint8_t b = *p++;
+        v |= (uint32_t)(b & 0x7F) << shift;
+        if(!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+void lzCompress(const uint8_t* in, size_t n, vector<uint8_t>& out) {
+    const int MIN_MATCH = 4, HASH_BITS = 12;
+    vector<int> last(1 << HASH_BITS, -1);
+    size_t i = 0, litStart = 0;
+    while(i + MIN_MATCH <= n) {
+        uint32_t seq;
+        memcpy(&seq, in + i, 4);
+        uint32_t hsh = (seq * 2654435761u) >> (32 - HASH_BITS);
+        int cand = last[hsh];
+        last[hsh] = (int)i;
+        if(cand >= 0 && memcmp(in + cand, in + i, MIN_MATCH) == 0) {
+            size_t len = MIN_MATCH;
+            while(i + len < n && in[cand + len] == in[i + len]) ++len;
+            putVarint(out, (uint32_t)(i - litStart));
+            out.insert(out.end(), in + litStart, in + i);
+            putVarint(out, (uint32_t)len);
+            putVarint(out, (uint32_t)(i - cand));
+            i += len;
+            litStart = i;
+        } else {
+            ++i;
+        }
+    }
+    putVarint(out, (uint32_t)(n - litStart));
+    out.insert(out.end(), in + litStart, in + n);
+    putVarint(out, 0);
+}
+
+// out must hold rawSize bytes. Returns false on corrupt input: a count or
+// match that runs past either buffer, or output of the wrong size.
+bool lzDecompress(const uint8_t* p, size_t packedSize, uint8_t* out, size_t rawSize) {
+    const uint8_t* end = p + packedSize;
+    size_t o = 0;
+    while(true) {
+        uint32_t lit, len, off;
+        if(!getVarint(p, end, lit) || lit > (size_t)(end - p) || lit > rawSize - o) return false;
+        memcpy(out + o, p, lit);
+        p += lit; o += lit;
+        if(!getVarint(p, end, len)) return false;
+        if(len == 0 || o >= rawSize) break;
+        if(!getVarint(p, end, off) || off == 0 || off > o || len > rawSize - o) return false;
+        for(uint32_t k=0;k<len;++k, ++o) out[o] = out[o - off]; // may overlap
+    }
+    return o == rawSize;
+}
+
+// Streaming writer: add() infosets in ascending key order.
+struct StrategyTableWriter {
+    FILE* f = nullptr;
+    bool ok = true;                 // false once any write or seek failed
+    StratHeader hdr;
+    vector<StratIndexEntry> index;
+    vector<StratBlockEntry> blocks;
+    vector<uint8_t> raw, packed;
+    int inBlock = 0;
+
+    bool open(const string& path, int quantBits) {
+        f = fopen(path.c_str(), "wb");
+        if(!f) return false;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.magic = STRAT_MAGIC;
+        hdr.version = STRAT_VERSION;
+        hdr.quantBits = (quantBits == 16 ? 16 : 8);
+        hdr.blockInfosets = BLOCK_INFOSETS;
+        ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;   // rewritten by close()
+        return true;
+    }
+
+    void add(uint64_t key, const float* probs, int numActions) {
+        StratIndexEntry e;
+        memset(&e, 0, sizeof(e));
+        e.key = key;
+        e.numActions = (uint8_t)numActions;
+        index.push_back(e);
+        int maxQ = (hdr.quantBits == 16 ? 65535 : 255);
+        for(int k=0;k<numActions;++k) {
+            int q = (int)lround(min(max(probs[k], 0.0f), 1.0f) * maxQ);
+            raw.push_back((uint8_t)q);
+            if(hdr.quantBits == 16) raw.push_back((uint8_t)(q >> 8));
+        }
+        if(++inBlock == BLOCK_INFOSETS) flushBlock();
+    }
+
+    void flushBlock() {
+        if(inBlock == 0) return;
+        packed.clear();
+        lzCompress(raw.data(), raw.size(), packed);
+        StratBlockEntry b;
+        long pos = ftell(f);
+        if(pos < 0) ok = false;
+        b.offset = (uint64_t)pos;
+        b.compressedSize = (uint32_t)packed.size();
+        b.rawSize = (uint32_t)raw.size();
+        if(fwrite(packed.data(), 1, packed.size(), f) != packed.size()) ok = false;
+        blocks.push_back(b);
+        raw.clear();
+        inBlock = 0;
+    }
+
+    // Writes the index, block table and final header. Returns false if
+    // any write, seek or the close failed (the file is then incomplete).
+    bool close() {
+        if(!f) return false;
+        flushBlock();
+        hdr.numInfosets = index.size();
+        hdr.numBlocks = blocks.size();
+        // pad so that the index and block table entries are 8-byte aligned
+        static const uint8_t zeros[8] = {0};
+        long pos = ftell(f);
+        if(pos < 0 || fwrite(zeros, 1, (8 - pos % 8) % 8, f) != (size_t)((8 - pos % 8) % 8)) ok = false;
+        pos = ftell(f);
+        hdr.indexOffset = (uint64_t)pos;
+        if(pos < 0 || fwrite(index.data(), sizeof(StratIndexEntry), index.size(), f) != index.size()) ok = false;
+        pos = ftell(f);
+        hdr.blockTabOffset = (uint64_t)pos;
+        if(pos < 0 || fwrite(blocks.data(), sizeof(StratBlockEntry), blocks.size(), f) != blocks.size()) ok = false;
+        if(fseek(f, 0, SEEK_SET) != 0 || fwrite(&hdr, sizeof(hdr), 1, f) != 1) ok = false;
+        if(fclose(f) != 0) ok = false;
+        f = nullptr;
+        return ok;
+    }
+};
+
+// Read-only mmap view of a strategy file.
+struct StrategyTable {
+    const uint8_t* base = nullptr;
+    size_t size = 0;
+    const StratHeader* hdr = nullptr;
+    const StratIndexEntry* index = nullptr;
+    const StratBlockEntry* blocks = nullptr;
+
+    // decoded blocks: block number -> (raw bytes, byte offset of each infoset)
+    struct Decoded { vector<uint8_t> raw; vector<uint32_t> offsets; };
+    static const int CACHE_BLOCKS = 64;
+    list<pair<uint64_t, Decoded>> cache;   // most recently used first
+    mutex cacheMutex;
+
+    bool open(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) return false;
+        struct stat sb;
+        if(fstat(fd, &sb) != 0 || (size_t)sb.st_size < sizeof(StratHeader)) { ::close(fd); return false; }
+        size = (size_t)sb.st_size;
+        void* m = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if(m == MAP_FAILED) return false;
+        base = (const uint8_t*)m;
+        hdr = (const StratHeader*)base;
+        if(!validLayout()) { close(); return false; }
+        index = (const StratIndexEntry*)(base + hdr->indexOffset);
+        blocks = (const StratBlockEntry*)(base + hdr->blockTabOffset);
+        return true;
+    }
+
+    // True if [offset, offset + count * width) lies inside the file.
+    bool inFile(uint64_t offset, uint64_t count, uint64_t width) const {
+        return offset <= size && count <= (size - offset) / width;
+    }
+
+    // Header fields, the (8-byte aligned) index, the block table and every
+    // block's bytes must lie inside the file. Each block's raw size is checked against
+    // the index when it is decoded, so open() stays off the index pages.
+    bool validLayout() const {
+        if(hdr->magic != STRAT_MAGIC || hdr->version != STRAT_VERSION) return false;
+        if((hdr->quantBits != 8 && hdr->quantBits != 16) || hdr->blockInfosets == 0) return false;
+        if(hdr->indexOffset % 8 || hdr->blockTabOffset % 8) return false;
+        if(!inFile(hdr->indexOffset, hdr->numInfosets, sizeof(StratIndexEntry))) return false;
+        if(!inFile(hdr->blockTabOffset, hdr->numBlocks, sizeof(StratBlockEntry))) return false;
+        if(hdr->numBlocks != (hdr->numInfosets + hdr->blockInfosets - 1) / hdr->blockInfosets) return false;
+        const StratBlockEntry* tab = (const StratBlockEntry*)(base + hdr->blockTabOffset);
+        for(uint64_t i=0;i<hdr->numBlocks;++i)
+            if(tab[i].offset < sizeof(StratHeader) || !inFile(tab[i].offset, tab[i].compressedSize, 1)) return false;
+        return true;
+    }
+
+    void close() {
+        if(base) munmap((void*)base, size);
+        base = nullptr;
+        hdr = nullptr;
+        cache.clear();
+    }
+
+    ~StrategyTable() { close(); }
+
+    // Fill probs (numActions entries, summing to 1) for key; returns the
+    // number of actions, or 0 if the key is not in the table or its block
+    // is corrupt.
+    int lookup(uint64_t key, float* probs) {
+        uint64_t n = hdr->numInfosets;
+        uint64_t lo = 0, hi = n;
+        while(lo < hi) {
+            uint64_t mid = (lo + hi) / 2;
+            if(index[mid].key < key) lo = mid + 1; else hi = mid;
+        }
+        if(lo == n || index[lo].key != key) return 0;
+        uint64_t blockNo = lo / hdr->blockInfosets;
+        int slot = (int)(lo % hdr->blockInfosets);
+        int numActions = index[lo].numActions;
+        int bytes = (hdr->quantBits == 16 ? 2 : 1);
+
+        lock_guard<mutex> lk(cacheMutex);
+        auto it = cache.begin();
+        while(it != cache.end() && it->first != blockNo) ++it;
+        if(it == cache.end()) {
+            Decoded d;
+            const StratBlockEntry& b = blocks[blockNo];
+            uint64_t first = blockNo * hdr->blockInfosets;
+            uint64_t last = min(n, first + hdr->blockInfosets);
+            uint64_t off = 0;
+            for(uint64_t i=first;i<last;++i) {
+                if(index[i].numActions < 1 || index[i].numActions > NUM_ACTIONS) return 0;
+                d.offsets.push_back((uint32_t)off);
+                off += index[i].numActions * bytes;
+            }
+            if(off != b.rawSize) return 0;
+            d.raw.resize(b.rawSize);
+            if(!lzDecompress(base + b.offset, b.compressedSize, d.raw.data(), b.rawSize)) return 0;
+            cache.emplace_front(blockNo, move(d));
+            if((int)cache.size() > CACHE_BLOCKS) cache.pop_back();
+        } else if(it != cache.begin()) {
+            cache.splice(cache.begin(), cache, it);
+        }
+        const Decoded& d = cache.front().second;
+        const uint8_t* p = d.raw.data() + d.offsets[slot];
+        float sum = 0;
+        for(int k=0;k<numActions;++k) {
+            int q = (bytes == 2 ? (p[2*k] | (p[2*k+1] << 8)) : p[k]);
+            probs[k] = (float)q;
+            sum += probs[k];
+        }
+        for(int k=0;k<numActions;++k) probs[k] = (sum > 0 ? probs[k] / sum : 1.0f / numActions);
+        return numActions;
+    }
+};
+
+// Infoset key for solver output: betting history, river slot and combo.
+inline uint64_t solverInfosetKey(HistoryKey history, int slot, int combo) {
+    return ((uint64_t)history << 17) | ((uint64_t)slot << 11) | (uint64_t)combo;
+}
+
+// Mode "strategy": re-solve a river spot, store the average strategy of
+// every decision node, reopen the file through mmap and check lookups.
+int runStrategyTable(const string& path, int quantBits, const CanonTable& table) {
+    FastEvaluator eval;
+    eval.build(table);
+    PublicState ps;
+    Deck deck;
+    deck.shuffle();
+    for(int k=0;k<5;++k) ps.board.push_back(deck.deal());
+
+    SubgameSolver solver(eval, 1);
+    ResolveResult res;
+    solver.setup(ps, res);
+    vector<float> ranges[2] = { ps.ranges[0], ps.ranges[1] };
+    removeBoardCombos(ps.board.data(), 5, ranges[0].data());
+    removeBoardCombos(ps.board.data(), 5, ranges[1].data());
+    SubgameSolver::Ctx ctx;
+    ctx.numBoard = 5;
+    for(int i=0;i<5;++i) ctx.board[i] = ps.board[i];
+    ctx.slot = 0;
+    ctx.river = solver.rankingFor(ctx.board);
+    vector<float> value(NUM_COMBOS);
+    for(int it=1; it<=200; ++it)
+        for(int trav=1; trav<=2; ++trav)
+            solver.cfr(ctx, solver.rootNode, trav, ranges[trav-1].data(), ranges[2-trav].data(),
+                       (float)it, false, value.data());
+
+    vector<float> probs((size_t)NUM_ACTIONS * NUM_COMBOS), one(NUM_ACTIONS);
+    vector<pair<uint64_t, vector<float>>> expected;
+    for(int node=0; node<(int)solver.tree.nodes.size(); ++node) {
+        const BettingNode& bn = solver.tree.nodes[node];
+        if(bn.type != NODE_DECISION) continue;
+        solver.averageStrategy(node, 0, probs.data());
+        for(int h=0;h<NUM_COMBOS;++h) {
+            if(ranges[0][h] == 0) continue;      // uses a board card
+            vector<float> p(bn.numChildren);
+            for(int k=0;k<bn.numChildren;++k) p[k] = probs[(size_t)k*NUM_COMBOS + h];
+            expected.push_back({solverInfosetKey(bn.history, 0, h), p});
+        }
+    }
+    // the writer wants ascending keys
+    sort(expected.begin(), expected.end());
+
+    StrategyTableWriter w;
+    if(!w.open(path, quantBits)) { cerr << "Cannot open " << path << " for writing\n"; return 1; }
+    for(auto& e : expected) w.add(e.first, e.second.data(), (int)e.second.size());
+    if(!w.close()) { cerr << "Write to " << path << " failed\n"; return 1; }
+    size_t rawBytes = 0;
+    for(auto& b : w.blocks) rawBytes += b.rawSize;
+    size_t packedBytes = 0;
+    for(auto& b : w.blocks) packedBytes += b.compressedSize;
+
+    auto t0 = chrono::steady_clock::now();
+    StrategyTable st;
+    if(!st.open(path)) { cerr << "Cannot map " << path << "\n"; return 1; }
+    double openUs = chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+
+    double maxErr = 0;
+    t0 = chrono::steady_clock::now();
+    for(auto& e : expected) {
+        int n = st.lookup(e.first, one.data());
+        for(int k=0;k<n;++k) maxErr = max(maxErr, (double)fabs(one[k] - e.second[k]));
+    }
+    double lookupSecs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    cout << "Infosets: " << st.hdr->numInfosets << "  Blocks: " << st.hdr->numBlocks
+         << "  Quantization: " << st.hdr->quantBits << " bits\n";
+    cout << "Strategy bytes: " << rawBytes << " raw, " << packedBytes << " compressed, file "
+         << st.size << "\n";
+    cout << "Open: " << openUs << " us  Lookups: " << expected.size() / lookupSecs << " /s"
+         << "  Max error: " << maxErr << "\n";
+    return 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION L — Hand-history import and batch re-evaluation
+   Reads PokerStars-style text hand histories:
+       PokerStars Hand #12: Hold'em Limit ($10/$20) - ...
+       Seat 1: Player1 ($10000 in chips)
+       *** FLOP *** [2c 7d 9h]
+       Player1: shows [Ah Kd] (...)
+       Player2 collected $80 from pot
+       Board [2c 7d 9h Js 3s]
+   The file is mapped read-only and split at hand headers into chunks
+   that threads parse independently. Lines are handled as string_views
+   into the mapping and per-hand state lives in fixed arrays, so the
+   tokenizer allocates nothing. Every showdown is re-evaluated with the
+   FastEvaluator and the computed winners are compared with the pot
+   collections recorded in the history.
+   The "hhwrite" mode produces such files from simulated hands.
+   ------------------------------------------------------------------ */
+
+const int HH_MAX_SEATS = 10;
+const char HH_HEADER[] = "PokerStars Hand #";
+
+// Read-only mapping of a whole file.
+struct MappedFile {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    bool open(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0) return false;
+        struct stat sb;
+        if(fstat(fd, &sb) != 0) { ::close(fd); return false; }
+        size = (size_t)sb.st_size;
+        if(size == 0) { ::close(fd); data = ""; return true; }
+        void* m = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if(m == MAP_FAILED) return false;
+        madvise(m, size, MADV_SEQUENTIAL);
+        data = (const char*)m;
+        return true;
+    }
+
+    ~MappedFile() { if(data && size) munmap((void*)data, size); }
+};
+
+// numChunks + 1 chunk boundaries, each snapped forward to the next hand
+// header at a line start (the first is the file start, the last its end),
+// so that every chunk holds whole hands. Empty chunks have equal bounds.
+vector<const char*> splitAtHandHeaders(const MappedFile& file, int numChunks) {
+    vector<const char*> bounds;
+    bounds.reserve(numChunks + 1);
+    const char* end = file.data + file.size;
+    size_t headerLen = strlen(HH_HEADER);
+    for(int i=0;i<numChunks;++i) {
+        const char* q = file.data + file.size * i / numChunks;
+        while(q < end) {
+            const char* hit = (const char*)memmem(q, end - q, HH_HEADER, headerLen);
+            if(!hit) { q = end; break; }
+            if(hit == file.data || hit[-1] == '\n') { q = hit; break; }
+            q = hit + 1;
+        }
+        if(i == 0) q = file.data;
+        bounds.push_back(q);
+    }
+    bounds.push_back(end);
+    return bounds;
+}
+
+struct HandHistoryStats {
+    long long hands = 0;
+    long long showdowns = 0;
+    long long agree = 0;            // computed winners == players who collected
+    long long mismatch = 0;
+    long long malformed = 0;        // showdowns with unreadable cards or board
+    long long winCategory[10] = {0};
+
+    void add(const HandHistoryStats& o) {
+        hands += o.hands; showdowns += o.showdowns; agree += o.agree;
+        mismatch += o.mismatch; malformed += o.malformed;
+        for(int i=0;i<10;++i) winCategory[i] += o.winCategory[i];
+    }
+};
+
+// Per-hand parse state; reset for each header. Amounts are in cents.
+struct ParsedHand {
+    int numSeats;
+    string_view names[HH_MAX_SEATS];
+    int shown[HH_MAX_SEATS][2];
+    bool hasShown[HH_MAX_SEATS];
+    bool collected[HH_MAX_SEATS];
+    long long invested[HH_MAX_SEATS];   // posted, bet, called or raised (minus uncalled returns)
+    long long streetInvested[HH_MAX_SEATS];
+    long long won[HH_MAX_SEATS];        // collected from the pot
+    int board[5];
+    int numBoard;
+    int allInBoard;             // board cards dealt at the last all-in, -1 if none
+    bool inSummary;
+    bool bad;
+
+    void reset() {
+        numSeats = 0;
+        numBoard = 0;
+        allInBoard = -1;
+        inSummary = false;
+        bad = false;
+        for(int i=0;i<HH_MAX_SEATS;++i) {
+            hasShown[i] = false; collected[i] = false;
+            invested[i] = streetInvested[i] = won[i] = 0;
+        }
+    }
+
+    int seatOf(string_view name) const {
+        for(int i=0;i<numSeats;++i) if(names[i] == name) return i;
+        return -1;
+    }
+};
+
+inline bool startsWith(string_view s, string_view prefix) {
+    return s.size() >= prefix.size() && memcmp(s.data(), prefix.data(), prefix.size()) == 0;
+}
+
+// Parse "$1,234.50" (the '$' is optional) starting at pos into cents.
+long long parseAmount(string_view s, size_t pos) {
+    if(pos < s.size() && s[pos] == '$') ++pos;
+    long long v = 0;
+    int decimals = -1;
+    for(; pos < s.size(); ++pos) {
+        char ch = s[pos];
+        if(ch >= '0' && ch <= '9') {
+            if(decimals >= 2) continue;
+            v = v*10 + (ch - '0');
+            if(decimals >= 0) ++decimals;
+        } else if(ch == '.' && decimals < 0) decimals = 0;
+        else if(ch != ',') break;
+    }
+    if(decimals < 0) decimals = 0;
+    for(; decimals < 2; ++decimals) v *= 10;
+    return v;
+}
+
+// Parse "[Ah Kd ...]" starting at the '[' at pos; returns the number of cards
+// written (up to maxCards), or -1 on a malformed card.
+int parseCardList(string_view s, size_t pos, int* out, int maxCards) {
+    int n = 0;
+    size_t i = pos + 1;
+    while(i + 1 < s.size() && s[i] != ']') {
+        if(s[i] == ' ') { ++i; continue; }
+        int c = parseCard(s[i], s[i+1]);
+        if(c < 0 || n == maxCards) return -1;
+        out[n++] = c;
+        i += 2;
+    }
+    return n;
+}
+
+void finishParsedHand(const ParsedHand& h, const FastEvaluator& eval, HandHistoryStats& st) {
+    ++st.hands;
+    int shownCount = 0;
+    for(int i=0;i<h.numSeats;++i) if(h.hasShown[i]) ++shownCount;
+    if(shownCount < 2) return;
+    ++st.showdowns;
+    if(h.bad || h.numBoard != 5) { ++st.malformed; return; }
+    int idx[HH_MAX_SEATS];
+    int best = INT_MAX;
+    for(int i=0;i<h.numSeats;++i) {
+        if(!h.hasShown[i]) continue;
+        int cards[7] = { h.shown[i][0], h.shown[i][1], h.board[0], h.board[1], h.board[2], h.board[3], h.board[4] };
+        idx[i] = eval.eval7(cards);
+        best = min(best, idx[i]);
+    }
+    bool same = true;
+    for(int i=0;i<h.numSeats;++i)
+        if(h.hasShown[i] && (idx[i] == best) != h.collected[i]) same = false;
+    if(same) ++st.agree; else ++st.mismatch;
+    ++st.winCategory[eval.categoryOf[best]];
+}
+
+// Called with every parsed hand, after the showdown check.
+typedef function<void(const ParsedHand& h)> ParsedHandSink;
+
+// Parse the hands in [p, end), which starts at a hand header (or is empty).
+void parseHandHistoryChunk(const char* p, const char* end, const FastEvaluator& eval, HandHistoryStats& st,
+                           const ParsedHandSink& onHand = nullptr) {
+    ParsedHand h;
+    h.reset();
+    bool inHand = false;
+    auto finish = [&]{
+        finishParsedHand(h, eval, st);
+        if(onHand) onHand(h);
+    };
+    while(p < end) {
+        const char* nl = (const char*)memchr(p, '\n', end - p);
+        const char* lineEnd = nl ? nl : end;
+        string_view line(p, lineEnd - p);
+        if(!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        p = nl ? nl + 1 : end;
+        if(line.empty()) continue;
+
+        if(startsWith(line, HH_HEADER)) {
+            if(inHand) finish();
+            h.reset();
+            inHand = true;
+            continue;
+        }
+        if(!inHand) continue;
+        if(startsWith(line, "*** SUMMARY ***")) { h.inSummary = true; continue; }
+        if(startsWith(line, "*** FLOP *** ") || startsWith(line, "*** TURN *** ") || startsWith(line, "*** RIVER *** "))
+            for(int i=0;i<h.numSeats;++i) h.streetInvested[i] = 0;
+        if(startsWith(line, "*** FLOP *** ")) {
+            size_t b = line.find('[');
+            int n = (b == string_view::npos ? -1 : parseCardList(line, b, h.board, 3));
+            if(n != 3) h.bad = true; else h.numBoard = 3;
+            continue;
+        }
+        if(startsWith(line, "*** TURN *** ") || startsWith(line, "*** RIVER *** ")) {
+            size_t b = line.rfind('[');
+            int c[1];
+            if(b == string_view::npos || parseCardList(line, b, c, 1) != 1 || h.numBoard >= 5) h.bad = true;
+            else h.board[h.numBoard++] = c[0];
+            continue;
+        }
+        if(startsWith(line, "Board [")) {
+            int n = parseCardList(line, 6, h.board, 5);
+            if(n < 0) h.bad = true; else h.numBoard = n;
+            continue;
+        }
+        if(!h.inSummary && startsWith(line, "Seat ")) {
+            size_t colon = line.find(": ");
+            size_t paren = line.rfind(" (");
+            if(colon != string_view::npos && paren != string_view::npos && paren > colon && h.numSeats < HH_MAX_SEATS)
+                h.names[h.numSeats++] = line.substr(colon + 2, paren - colon - 2);
+            continue;
+        }
+        size_t pos;
+        if((pos = line.find(": shows [")) != string_view::npos) {
+            int seat = h.seatOf(line.substr(0, pos));
+            int c[2];
+            if(seat < 0 || parseCardList(line, pos + 8, c, 2) != 2) { h.bad = true; continue; }
+            h.shown[seat][0] = c[0];
+            h.shown[seat][1] = c[1];
+            h.hasShown[seat] = true;
+            continue;
+        }
+        if(!h.inSummary && (pos = line.find(" collected ")) != string_view::npos) {
+            int seat = h.seatOf(line.substr(0, pos));
+            if(seat >= 0) {
+                h.collected[seat] = true;
+                h.won[seat] += parseAmount(line, pos + 11);
+            }
+            continue;
+        }
+        if(startsWith(line, "Uncalled bet (")) {
+            size_t to = line.find(") returned to ");
+            int seat = (to == string_view::npos ? -1 : h.seatOf(line.substr(to + 14)));
+            if(seat >= 0) {
+                long long amt = parseAmount(line, 14);
+                h.invested[seat] -= amt;
+                h.streetInvested[seat] -= amt;
+            }
+            continue;
+        }
+        // "name: posts/bets/calls $X", "name: raises $X to $Y", optionally "and is all-in"
+        if(!h.inSummary && (pos = line.find(": ")) != string_view::npos) {
+            int seat = h.seatOf(line.substr(0, pos));
+            if(seat < 0) continue;
+            string_view rest = line.substr(pos + 2);
+            long long add = 0;
+            if(startsWith(rest, "posts ") || startsWith(rest, "bets ") || startsWith(rest, "calls ")) {
+                size_t d = rest.find('$');
+                if(d != string_view::npos) add = parseAmount(rest, d);
+            } else if(startsWith(rest, "raises ")) {
+                size_t to = rest.find(" to ");
+                if(to != string_view::npos) add = parseAmount(rest, to + 4) - h.streetInvested[seat];
+            }
+            h.invested[seat] += add;
+            h.streetInvested[seat] += add;
+            if(rest.find("is all-in") != string_view::npos) h.allInBoard = h.numBoard;
+            continue;
+        }
+    }
+    if(inHand) finish();
+}
+
+// Mode "hhimport": parse and re-evaluate a hand-history file on all cores.
+int runHandHistoryImport(const string& path, const CanonTable& table) {
+    MappedFile file;
+    if(!file.open(path)) { cerr << "Cannot map " << path << "\n"; return 1; }
+    FastEvaluator eval;
+    eval.build(table);
+
+    int threads = max(1u, thread::hardware_concurrency());
+    int numChunks = threads * 8;
+    vector<const char*> bounds = splitAtHandHeaders(file, numChunks);
+
+    vector<HandHistoryStats> stats(numChunks);
+    auto t0 = chrono::steady_clock::now();
+    parallelFor(numChunks, threads, [&](int i) {
+        if(bounds[i] < bounds[i+1]) parseHandHistoryChunk(bounds[i], bounds[i+1], eval, stats[i]);
+    });
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    HandHistoryStats total;
+    for(auto& s : stats) total.add(s);
+    cout << "File: " << path << " (" << file.size << " bytes) on " << threads << " threads\n";
+    cout << "Hands: " << total.hands << "  Showdowns: " << total.showdowns
+         << "  Winners agree: " << total.agree << "  Mismatch: " << total.mismatch
+         << "  Malformed: " << total.malformed << "\n";
+    for(int c=CAT_STRAIGHT_FLUSH; c<=CAT_HIGH_CARD; ++c)
+        if(total.winCategory[c]) cout << "  Won with " << categoryName(c) << ": " << total.winCategory[c] << "\n";
+    double mbps = file.size / secs / (1 << 20);
+    cout << "Time: " << secs << " s  (" << total.hands / secs << " hands/s, " << mbps << " MB/s, "
+         << mbps * 3600 / 1024 << " GB/hour)\n";
+    return 0;
+}
+
+// Write one heads-up hand where both players get all-in ($1000 stacks)
+// on the preflop, flop or turn, for testing all-in analytics.
+void writeAllInHand(FILE* f, int n, HandRng& g, const CanonTable& table) {
+    const char* names[2] = {"Player1", "Player2"};
+    LockstepHand h;
+    lockstepDeal(h, n, g);
+    int sb = h.firstToAct - 1, bb = 1 - sb;
+    auto cards = [](const int* c, int k) {
+        string out;
+        for(int i=0;i<k;++i) {
+            if(i) out += ' ';
+            out += cardShortString(c[i]);
+        }
+        return out;
+    };
+    int street = (int)g.below(3);
+    fprintf(f, "PokerStars Hand #%d:  Hold'em No Limit ($10/$20) - 2026/01/01 00:00:00 ET\n", n);
+    fprintf(f, "Table 'Sim' 2-max Seat #%d is the button\n", sb + 1);
+    for(int i=0;i<2;++i) fprintf(f, "Seat %d: %s ($1000 in chips)\n", i + 1, names[i]);
+    fprintf(f, "%s: posts small blind $10\n%s: posts big blind $20\n", names[sb], names[bb]);
+    fprintf(f, "*** HOLE CARDS ***\n");
+    for(int i=0;i<2;++i) fprintf(f, "Dealt to %s [%s]\n", names[i], cards(h.hole[i], 2).c_str());
+    if(street == 0) {
+        fprintf(f, "%s: raises $980 to $1000 and is all-in\n", names[sb]);
+        fprintf(f, "%s: calls $980 and is all-in\n", names[bb]);
+    } else {
+        fprintf(f, "%s: calls $10\n%s: checks\n", names[sb], names[bb]);
+    }
+    for(int s=1; s<=3; ++s) {
+        if(s == 1) fprintf(f, "*** FLOP *** [%s]\n", cards(h.board, 3).c_str());
+        if(s == 2) fprintf(f, "*** TURN *** [%s] [%s]\n", cards(h.board, 3).c_str(), cards(h.board + 3, 1).c_str());
+        if(s == 3) fprintf(f, "*** RIVER *** [%s] [%s]\n", cards(h.board, 4).c_str(), cards(h.board + 4, 1).c_str());
+        if(s < street) fprintf(f, "%s: checks\n%s: checks\n", names[bb], names[sb]);
+        if(s == street) {
+            fprintf(f, "%s: bets $980 and is all-in\n", names[bb]);
+            fprintf(f, "%s: calls $980 and is all-in\n", names[sb]);
+        }
+    }
+    fprintf(f, "*** SHOW DOWN ***\n");
+    for(int i=0;i<2;++i) fprintf(f, "%s: shows [%s]\n", names[i], cards(h.hole[i], 2).c_str());
+    vector<int> all1 = {h.hole[0][0], h.hole[0][1]}, all2 = {h.hole[1][0], h.hole[1][1]};
+    all1.insert(all1.end(), h.board, h.board + 5);
+    all2.insert(all2.end(), h.board, h.board + 5);
+    int idx1 = evaluate7_bestIndex(all1, table), idx2 = evaluate7_bestIndex(all2, table);
+    if(idx1 != idx2) fprintf(f, "%s collected $2000 from pot\n", names[idx1 < idx2 ? 0 : 1]);
+    else for(int i=0;i<2;++i) fprintf(f, "%s collected $1000 from pot\n", names[i]);
+    fprintf(f, "*** SUMMARY ***\nTotal pot $2000 | Rake $0\nBoard [%s]\n\n\n", cards(h.board, 5).c_str());
+}
+
+// Mode "hhwrite": write numHands simulated hands in the format above;
+// allInPercent of them are all-in confrontations (see writeAllInHand).
+int runHandHistoryWrite(const string& path, int numHands, int allInPercent, const CanonTable& table) {
+    FILE* f = fopen(path.c_str(), "w");
+    if(!f) { cerr << "Cannot open " << path << " for writing\n"; return 1; }
+    uint64_t runSeed = ((uint64_t)random_device{}() << 32) | random_device{}();
+    const char* names[2] = {"Player1", "Player2"};
+    string a, b, c, d, e;
+    for(int n=1; n<=numHands; ++n) {
+        HandRng g(runSeed, (uint64_t)n);
+        if((int)g.below(100) < allInPercent) { writeAllInHand(f, n, g, table); continue; }
+        LockstepHand h;
+        lockstepDeal(h, n, g);
+        int sb = h.firstToAct - 1;
+        fprintf(f, "PokerStars Hand #%d:  Hold'em Limit ($20/$40) - 2026/01/01 00:00:00 ET\n", n);
+        fprintf(f, "Table 'Sim' 2-max Seat #%d is the button\n", sb + 1);
+        for(int i=0;i<2;++i) fprintf(f, "Seat %d: %s ($10000 in chips)\n", i + 1, names[i]);
+        fprintf(f, "%s: posts small blind $10\n%s: posts big blind $20\n", names[sb], names[1 - sb]);
+        fprintf(f, "*** HOLE CARDS ***\n");
+        for(int i=0;i<2;++i) {
+            a = cardShortString(h.hole[i][0]); b = cardShortString(h.hole[i][1]);
+            fprintf(f, "Dealt to %s [%s %s]\n", names[i], a.c_str(), b.c_str());
+        }
+        int base[2] = {0, 0};       // chips put in before the current street
+        while(!h.done) {
+            int actor = h.st.current - 1;
+            int streetNow = h.street;
+            int before[2] = { h.st.firstPlayerChipsOnPot, h.st.secondPlayerChipsOnPot };
+            int mask = legalMask(h.st);
+            int pick = g.below(__builtin_popcount(mask));
+            int act = __builtin_ctz(mask);
+            for(int k=0;k<pick;++k) act = __builtin_ctz(mask &= mask - 1);
+            lockstepApply(h, (Action)act, table);
+            // chips of the actor after the action, on this street
+            int after = (h.done || h.street != streetNow) ? h.chips[actor] - base[actor]
+                       : (actor == 0 ? h.st.firstPlayerChipsOnPot : h.st.secondPlayerChipsOnPot);
+            switch(act) {
+                case A_CHECK: fprintf(f, "%s: checks\n", names[actor]); break;
+                case A_BET:   fprintf(f, "%s: bets $%d\n", names[actor], after - before[actor]); break;
+                case A_CALL:  fprintf(f, "%s: calls $%d\n", names[actor], after - before[actor]); break;
+                case A_RAISE: fprintf(f, "%s: raises $%d to $%d\n", names[actor], after - before[1 - actor], after); break;
+                case A_FOLD:  fprintf(f, "%s: folds\n", names[actor]); break;
+            }
+            if(!h.done && h.street != streetNow) {
+                base[0] = h.chips[0];
+                base[1] = h.chips[1];
+                a = cardShortString(h.board[0]); b = cardShortString(h.board[1]); c = cardShortString(h.board[2]);
+                if(h.street == 1) fprintf(f, "*** FLOP *** [%s %s %s]\n", a.c_str(), b.c_str(), c.c_str());
+                d = cardShortString(h.board[3]);
+                if(h.street == 2) fprintf(f, "*** TURN *** [%s %s %s] [%s]\n", a.c_str(), b.c_str(), c.c_str(), d.c_str());
+                e = cardShortString(h.board[4]);
+                if(h.street == 3) fprintf(f, "*** RIVER *** [%s %s %s %s] [%s]\n", a.c_str(), b.c_str(), c.c_str(), d.c_str(), e.c_str());
+            }
+        }
+        bool showdown = h.st.lastAction != A_FOLD;
+        if(showdown) {
+            fprintf(f, "*** SHOW DOWN ***\n");
+            for(int i=0;i<2;++i) {
+                a = cardShortString(h.hole[i][0]); b = cardShortString(h.hole[i][1]);
+                fprintf(f, "%s: shows [%s %s]\n", names[i], a.c_str(), b.c_str());
+            }
+        }
+        if(h.result > 0) fprintf(f, "%s collected $%d from pot\n", names[0], h.pot);
+        else if(h.result < 0) fprintf(f, "%s collected $%d from pot\n", names[1], h.pot);
+        else for(int i=0;i<2;++i) fprintf(f, "%s collected $%d from pot\n", names[i], h.pot / 2);
+        fprintf(f, "*** SUMMARY ***\nTotal pot $%d | Rake $0\n", h.pot);
+        if(showdown) {
+            a = cardShortString(h.board[0]); b = cardShortString(h.board[1]); c = cardShortString(h.board[2]);
+            d = cardShortString(h.board[3]); e = cardShortString(h.board[4]);
+            fprintf(f, "Board [%s %s %s %s %s]\n", a.c_str(), b.c_str(), c.c_str(), d.c_str(), e.c_str());
+        }
+        fprintf(f, "\n\n");
+    }
+    fclose(f);
+    cout << "Wrote " << numHands << " hands to " << path << " (run seed " << runSeed << ")\n";
+    return 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION M — All-in adjusted expectation over hand streams
+   When the betting stops with players all-in before the river, the
+   result of the hand is luck from that point on. For those hands we
+   enumerate every completion of the board (exact equity) and credit
+   each player with equity * pot instead of what they collected; all
+   other hands count at their actual result. Equities are memoized in
+   a sharded cache keyed by the hole cards and board after suit
+   relabeling, so repeated matchups (very common preflop) cost a hash
+   lookup. Parsing, enumeration and accumulation run in parallel over
+   the same file chunks as Section L.
+   Side pots are not split out: all players who showed compete for the
+   whole pot.
+   ------------------------------------------------------------------ */
+
+// Best 5-card index of every 7-card rank multiset without a flush, keyed
+// by the product of the card primes. Most runouts in an enumeration
+// have no flush, so they cost one hash lookup instead of 21 eval5 calls.
+template<class Rules>
+struct BasicNoFlush7Table {
+    unordered_map<uint64_t, uint16_t> best;
+
+    void build(const BasicFastEvaluator<Rules>& eval) {
+        best.reserve(1 << 17);
+        int counts[13] = {0};
+        // spread suits round-robin so no representative hand is a flush
+        function<void(int, int)> rec = [&](int rank, int left) {
+            if(left == 0) {
+                int cards[7], n = 0;
+                uint64_t product = 1;
+                for(int r=0;r<13;++r) for(int k=0;k<counts[r];++k) {
+                    cards[n] = COMBOS.encoded[(n % 4)*13 + r];
+                    product *= (uint64_t)(cards[n] & 0xFF);
+                    ++n;
+                }
+                best[product] = (uint16_t)eval.eval7(cards);
+                return;
+            }
+            if(rank == 13) return;
+            for(int k=min(4, left); k>=0; --k) {
+                counts[rank] = k;
+                rec(rank + 1, left - k);
+            }
+            counts[rank] = 0;
+        };
+        rec(Rules::LOW_RANK - 2, 7);
+    }
+
+    // Same result as eval.eval7(c).
+    int eval7(const int* c, const BasicFastEvaluator<Rules>& eval) const {
+        int suits[4] = {0, 0, 0, 0};
+        uint64_t product = 1;
+        for(int i=0;i<7;++i) {
+            ++suits[cardSuit(c[i])];
+            product *= (uint64_t)(c[i] & 0xFF);
+        }
+        if(suits[0] >= 5 || suits[1] >= 5 || suits[2] >= 5 || suits[3] >= 5) return eval.eval7(c);
+        return best.find(product)->second;
+    }
+};
+
+typedef BasicNoFlush7Table<StandardRules> NoFlush7Table;
+
+// Exact pot share of each player over all completions of the board
+// (ties split evenly). hole[i] are encoded cards; equity sums to 1.
+void exactEquity(const int (*hole)[2], int numPlayers, const int* board, int numBoard,
+                 const FastEvaluator& eval, const NoFlush7Table& noFlush, double* equity) {
+    uint64_t dead = 0;
+    for(int i=0;i<numPlayers;++i) dead |= (1ULL << cardIndex(hole[i][0])) | (1ULL << cardIndex(hole[i][1]));
+    for(int i=0;i<numBoard;++i) dead |= 1ULL << cardIndex(board[i]);
+    int deck[52], n = 0;
+    for(int c=0;c<52;++c) if(!((dead >> c) & 1)) deck[n++] = COMBOS.encoded[c];
+
+    int need = 5 - numBoard;
+    int cards[HH_MAX_SEATS][7];
+    for(int i=0;i<numPlayers;++i) {
+        cards[i][0] = hole[i][0];
+        cards[i][1] = hole[i][1];
+        for(int k=0;k<numBoard;++k) cards[i][2+k] = board[k];
+    }
+    vector<double> share(numPlayers, 0.0);
+    long long runouts = 0;
+    int pick[5];
+    // iterate increasing index tuples pick[0] < ... < pick[need-1]
+    for(int k=0;k<need;++k) pick[k] = k;
+    while(true) {
+        int best = INT_MAX, winners = 0;
+        int idx[HH_MAX_SEATS];
+        for(int i=0;i<numPlayers;++i) {
+            for(int k=0;k<need;++k) cards[i][2 + numBoard + k] = deck[pick[k]];
+            idx[i] = noFlush.eval7(cards[i], eval);
+            if(idx[i] < best) { best = idx[i]; winners = 1; }
+            else if(idx[i] == best) ++winners;
+        }
+        for(int i=0;i<numPlayers;++i) if(idx[i] == best) share[i] += 1.0 / winners;
+        ++runouts;
+        int k = need - 1;
+        while(k >= 0 && pick[k] == n - need + k) --k;
+        if(k < 0) break;
+        ++pick[k];
+        for(int j=k+1;j<need;++j) pick[j] = pick[j-1] + 1;
+    }
+    for(int i=0;i<numPlayers;++i) equity[i] = share[i] / runouts;
+}
+
+// Cache key: player count, board size and the cards after sorting each
+// player's pair and the board and renaming suits in order of appearance
+// (player order is kept, so the cached equities line up with the players).
+struct EquityKey {
+    uint8_t numPlayers, numBoard;
+    uint8_t cards[2*HH_MAX_SEATS + 5];
+
+    bool operator==(const EquityKey& o) const {
+        return numPlayers == o.numPlayers && numBoard == o.numBoard &&
+               memcmp(cards, o.cards, 2*numPlayers + numBoard) == 0;
+    }
+};
+
+struct EquityKeyHash {
+    size_t operator()(const EquityKey& k) const {
+        uint64_t h = 1469598103934665603ULL ^ (k.numPlayers * 31 + k.numBoard);
+        for(int i=0;i<2*k.numPlayers + k.numBoard;++i) { h ^= k.cards[i]; h *= 1099511628211ULL; }
+        return (size_t)h;
+    }
+};
+
+EquityKey makeEquityKey(const int (*hole)[2], int numPlayers, const int* board, int numBoard) {
+    EquityKey key;
+    memset(&key, 0, sizeof(key));
+    key.numPlayers = (uint8_t)numPlayers;
+    key.numBoard = (uint8_t)numBoard;
+    int suitMap[4] = {-1, -1, -1, -1}, nextSuit = 0;
+    auto relabel = [&](int card) {
+        int su = cardSuit(card);
+        if(suitMap[su] < 0) suitMap[su] = nextSuit++;
+        return (uint8_t)(suitMap[su]*13 + cardRank(card) - 2);
+    };
+    for(int i=0;i<numPlayers;++i) {
+        // order the pair by rank first so relabeling does not depend on deal order
+        int a = hole[i][0], b = hole[i][1];
+        if(cardRank(a) < cardRank(b) || (cardRank(a) == cardRank(b) && cardSuit(a) > cardSuit(b))) swap(a, b);
+        uint8_t x = relabel(a), y = relabel(b);
+        key.cards[2*i] = min(x, y);
+        key.cards[2*i+1] = max(x, y);
+    }
+    // board by descending rank (then suit) before relabeling, then as indices
+    int sorted[5];
+    for(int i=0;i<numBoard;++i) {
+        int c = board[i], j = i;
+        for(; j>0 && (cardRank(sorted[j-1]) < cardRank(c) ||
+                      (cardRank(sorted[j-1]) == cardRank(c) && cardSuit(sorted[j-1]) > cardSuit(c))); --j)
+            sorted[j] = sorted[j-1];
+        sorted[j] = c;
+    }
+    uint8_t* out = key.cards + 2*numPlayers;
+    for(int i=0;i<numBoard;++i) out[i] = relabel(sorted[i]);
+    sort(out, out + numBoard);
+    return key;
+}
+
+struct EquityCache {
+    static const int SHARDS = 64;
+    struct Shard {
+        mutex m;
+        unordered_map<EquityKey, array<float, HH_MAX_SEATS>, EquityKeyHash> map;
+    };
+    Shard shards[SHARDS];
+    atomic<long long> hits{0}, misses{0};
+
+    void equity(const int (*hole)[2], int numPlayers, const int* board, int numBoard,
+                const FastEvaluator& eval, const NoFlush7Table& noFlush, double* out) {
+        EquityKey key = makeEquityKey(hole, numPlayers, board, numBoard);
+        Shard& sh = shards[EquityKeyHash()(key) % SHARDS];
+        {
+            lock_guard<mutex> lk(sh.m);
+            auto it = sh.map.find(key);
+            if(it != sh.map.end()) {
+                ++hits;
+                for(int i=0;i<numPlayers;++i) out[i] = it->second[i];
+                return;
+            }
+        }
+        ++misses;
+        exactEquity(hole, numPlayers, board, numBoard, eval, noFlush, out);
+        array<float, HH_MAX_SEATS> val{};
+        for(int i=0;i<numPlayers;++i) val[i] = (float)out[i];
+        lock_guard<mutex> lk(sh.m);
+        sh.map.emplace(key, val);
+    }
+};
+
+// Per-player totals in cents.
+struct PlayerEV {
+    long long hands = 0;
+    long long allInHands = 0;
+    long long net = 0;          // actual winnings
+    double evNet = 0;           // all-in adjusted winnings
+};
+
+// Account one parsed hand into stats (by player name). The keys are the
+// parsed names themselves, views into the mapped file, so a lookup never
+// copies the name and only a first sighting allocates a node.
+void accumulateAllInEV(const ParsedHand& h, const FastEvaluator& eval, const NoFlush7Table& noFlush,
+                       EquityCache& cache,
+                       unordered_map<string_view, PlayerEV>& stats, long long& allInHands) {
+    int shownSeats[HH_MAX_SEATS], numShown = 0;
+    for(int i=0;i<h.numSeats;++i) if(h.hasShown[i]) shownSeats[numShown++] = i;
+    bool allIn = !h.bad && numShown >= 2 && h.numBoard == 5 && h.allInBoard >= 0 && h.allInBoard < 5;
+
+    double equity[HH_MAX_SEATS] = {0};
+    long long pot = 0;
+    if(allIn) {
+        int hole[HH_MAX_SEATS][2];
+        for(int k=0;k<numShown;++k) {
+            hole[k][0] = h.shown[shownSeats[k]][0];
+            hole[k][1] = h.shown[shownSeats[k]][1];
+        }
+        cache.equity(hole, numShown, h.board, h.allInBoard, eval, noFlush, equity);
+        for(int i=0;i<h.numSeats;++i) pot += h.won[i];
+        ++allInHands;
+    }
+    int k = 0;
+    for(int i=0;i<h.numSeats;++i) {
+        PlayerEV& p = stats[h.names[i]];
+        long long actual = h.won[i] - h.invested[i];
+        ++p.hands;
+        p.net += actual;
+        if(allIn && h.hasShown[i]) {
+            ++p.allInHands;
+            p.evNet += equity[k++] * pot - h.invested[i];
+        } else {
+            p.evNet += actual;
+        }
+    }
+}
+
+// Mode "allinev": all-in adjusted results per player for a hand-history file.
+int runAllInEV(const string& path, const CanonTable& table) {
+    MappedFile file;
+    if(!file.open(path)) { cerr << "Cannot map " << path << "\n"; return 1; }
+    FastEvaluator eval;
+    eval.build(table);
+    NoFlush7Table noFlush;
+    noFlush.build(eval);
+    EquityCache cache;
+
+    int threads = max(1u, thread::hardware_concurrency());
+    int numChunks = threads * 8;
+    vector<const char*> bounds = splitAtHandHeaders(file, numChunks);
+
+    vector<HandHistoryStats> hhStats(numChunks);
+    vector<unordered_map<string_view, PlayerEV>> evStats(numChunks);
+    vector<long long> allInCounts(numChunks, 0);
+    auto t0 = chrono::steady_clock::now();
+    parallelFor(numChunks, threads, [&](int i) {
+        if(bounds[i] >= bounds[i+1]) return;
+        parseHandHistoryChunk(bounds[i], bounds[i+1], eval, hhStats[i], [&](const ParsedHand& h) {
+            accumulateAllInEV(h, eval, noFlush, cache, evStats[i], allInCounts[i]);
+        });
+    });
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    HandHistoryStats total;
+    for(auto& s : hhStats) total.add(s);
+    unordered_map<string_view, PlayerEV> merged;
+    long long allInHands = 0;
+    for(int i=0;i<numChunks;++i) {
+        allInHands += allInCounts[i];
+        for(auto& kv : evStats[i]) {
+            PlayerEV& m = merged[kv.first];
+            m.hands += kv.second.hands;
+            m.allInHands += kv.second.allInHands;
+            m.net += kv.second.net;
+            m.evNet += kv.second.evNet;
+        }
+    }
+    vector<pair<string_view, PlayerEV>> rows(merged.begin(), merged.end());
+    sort(rows.begin(), rows.end(), [](const pair<string_view, PlayerEV>& a, const pair<string_view, PlayerEV>& b){
+        return a.second.hands > b.second.hands;
+    });
+
+    cout << "Hands: " << total.hands << "  All-in before river: " << allInHands
+         << "  Equity cache: " << cache.hits << " hits, " << cache.misses << " misses\n";
+    cout << fixed << setprecision(2);
+    cout << "Player            Hands   All-in        Net ($)     All-in EV ($)    Luck ($)\n";
+    for(size_t i=0;i<rows.size() && i<20;++i) {
+        const PlayerEV& p = rows[i].second;
+        cout << left << setw(16) << rows[i].first << right << setw(8) << p.hands << setw(9) << p.allInHands
+             << setw(15) << p.net / 100.0 << setw(18) << p.evNet / 100.0
+             << setw(12) << (p.net - p.evNet) / 100.0 << "\n";
+    }
+    cout << defaultfloat << "Time: " << secs << " s  (" << total.hands / secs << " hands/s)\n";
+    return 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION N — Omaha (PLO4 / PLO5) evaluation
+   An Omaha hand must use exactly two hole cards and three board cards:
+   6 hole pairs x 10 board triples = 60 five-card hands for PLO4, 100
+   for PLO5. Everything about the board that does not depend on the
+   hole cards is prepared once per board (OmahaBoard) and shared by
+   every holding evaluated on it:
+   - Without a flush the value depends only on ranks. A global table
+     gives the index of (hole rank pair, board rank triple), and the
+     board keeps the best value per hole rank pair (91 of them),
+     filled on first use, so a holding costs one read per hole pair.
+   - A flush needs three board cards of one suit; at most one suit
+     qualifies and only hole pairs of that suit are checked, against
+     the precomputed rank bits of the board's suited triples.
+   ------------------------------------------------------------------ */
+
+const int OMAHA_RANK_PAIRS = 91;       // unordered rank pairs with repetition
+const int OMAHA_RANK_TRIPLES = 455;    // rank multisets of size 3
+
+template<class Rules>
+struct BasicOmahaTables {
+    uint8_t pairIndex[13][13];
+    uint16_t tripleIndex[13][13][13];          // ranks in any order
+    vector<uint16_t> nonFlush;                 // [pair * 455 + triple], 0xFFFF = impossible
+
+    void build(const BasicFastEvaluator<Rules>& eval) {
+        const int low = Rules::LOW_RANK - 2;
+        int n = 0;
+        for(int a=0;a<13;++a) for(int b=a;b<13;++b) pairIndex[a][b] = pairIndex[b][a] = (uint8_t)n++;
+        vector<array<int,3>> triples;
+        for(int a=0;a<13;++a) for(int b=a;b<13;++b) for(int c=b;c<13;++c) {
+            int t = (int)triples.size();
+            triples.push_back({a, b, c});
+            int p[3] = {a, b, c};
+            sort(p, p + 3);
+            do tripleIndex[p[0]][p[1]][p[2]] = (uint16_t)t; while(next_permutation(p, p + 3));
+        }
+        nonFlush.assign(OMAHA_RANK_PAIRS * OMAHA_RANK_TRIPLES, 0xFFFF);
+        for(int a=low;a<13;++a) for(int b=a;b<13;++b) for(int t=0;t<OMAHA_RANK_TRIPLES;++t) {
+            int r[5] = {a, b, triples[t][0], triples[t][1], triples[t][2]};
+            sort(r, r + 5);
+            if(r[0] == r[4] || r[0] < low) continue;  // five of a kind, or not in this deck
+            // suit k%4 for the k-th sorted card: equal ranks get distinct suits, never a flush
+            int c[5];
+            for(int k=0;k<5;++k) c[k] = encodeCard(r[k] + 2, k % 4);
+            nonFlush[pairIndex[a][b] * OMAHA_RANK_TRIPLES + t] = (uint16_t)eval.eval5(c[0], c[1], c[2], c[3], c[4]);
+        }
+    }
+};
+
+// Per-board state shared by all holdings evaluated on one 5-card board.
+template<class Rules>
+struct BasicOmahaBoard {
+    const BasicOmahaTables<Rules>* tables;
+    const BasicFastEvaluator<Rules>* eval;
+    uint16_t triples[10];        // distinct board rank triples (OmahaTables index)
+    int numTriples;
+    uint16_t pairBest[OMAHA_RANK_PAIRS];   // best non-flush index per hole rank pair, 0 = not yet computed
+    int flushSuit;               // suit with 3+ board cards, -1 if none
+    int flushTriples[10];        // rank bits of each 3-card subset of that suit
+    int numFlushTriples;
+
+    void prepare(const int* board, const BasicOmahaTables<Rules>& t, const BasicFastEvaluator<Rules>& e) {
+        tables = &t;
+        eval = &e;
+        numTriples = 0;
+        for(int a=0;a<5;++a) for(int b=a+1;b<5;++b) for(int c=b+1;c<5;++c) {
+            uint16_t idx = t.tripleIndex[cardRank(board[a])-2][cardRank(board[b])-2][cardRank(board[c])-2];
+            if(find(triples, triples + numTriples, idx) == triples + numTriples) triples[numTriples++] = idx;
+        }
+        memset(pairBest, 0, sizeof(pairBest));
+        int suitCount[4] = {0, 0, 0, 0};
+        for(int i=0;i<5;++i) ++suitCount[cardSuit(board[i])];
+        flushSuit = -1;
+        numFlushTriples = 0;
+        for(int s=0;s<4;++s) if(suitCount[s] >= 3) flushSuit = s;
+        if(flushSuit < 0) return;
+        int suited[5], n = 0;
+        for(int i=0;i<5;++i) if(cardSuit(board[i]) == flushSuit) suited[n++] = (board[i] >> 16) & 0x1FFF;
+        for(int a=0;a<n;++a) for(int b=a+1;b<n;++b) for(int c=b+1;c<n;++c)
+            flushTriples[numFlushTriples++] = suited[a] | suited[b] | suited[c];
+    }
+
+    int pairValue(int r1, int r2) {
+        int p = tables->pairIndex[r1][r2];
+        if(!pairBest[p]) {
+            int best = 0xFFFF;
+            const uint16_t* row = &tables->nonFlush[p * OMAHA_RANK_TRIPLES];
+            for(int i=0;i<numTriples;++i) best = min(best, (int)row[triples[i]]);
+            pairBest[p] = (uint16_t)best;
+        }
+        return pairBest[p];
+    }
+
+    // Best index (1 = best) for numHole hole cards (4 or 5).
+    int evaluate(const int* hole, int numHole) {
+        int best = INT_MAX;
+        for(int i=0;i<numHole;++i) for(int j=i+1;j<numHole;++j) {
+            best = min(best, pairValue(cardRank(hole[i]) - 2, cardRank(hole[j]) - 2));
+            if(flushSuit >= 0 && (hole[i] & hole[j] & (0x1000 << flushSuit))) {
+                int bits = ((hole[i] | hole[j]) >> 16) & 0x1FFF;
+                for(int k=0;k<numFlushTriples;++k) best = min(best, (int)eval->flushes[bits | flushTriples[k]]);
+            }
+        }
+        return best;
+    }
+};
+
+typedef BasicOmahaTables<StandardRules> OmahaTables;
+typedef BasicOmahaBoard<StandardRules> OmahaBoard;
+
+// Reference: every (2 hole, 3 board) combination through eval5.
+int omahaBruteForce(const int* hole, int numHole, const int* board, const FastEvaluator& eval) {
+    int best = INT_MAX;
+    for(int i=0;i<numHole;++i) for(int j=i+1;j<numHole;++j)
+    for(int a=0;a<5;++a) for(int b=a+1;b<5;++b) for(int c=b+1;c<5;++c)
+        best = min(best, eval.eval5(hole[i], hole[j], board[a], board[b], board[c]));
+    return best;
+}
+
+// Split-pot showdown: half the pot to the best high hand(s) and half to the
+// best qualifying low(s) (lo 0 = no low); with no low the high hand scoops.
+// Adds each player's fraction of the pot to share.
+void hiLoShowdown(const int* hi, const int* lo, int np, double* share) {
+    int bestHi = INT_MAX, hiWinners = 0, bestLo = INT_MAX, loWinners = 0;
+    for(int i=0;i<np;++i) {
+        if(hi[i] < bestHi) { bestHi = hi[i]; hiWinners = 1; }
+        else if(hi[i] == bestHi) ++hiWinners;
+        if(!lo[i]) continue;
+        if(lo[i] < bestLo) { bestLo = lo[i]; loWinners = 1; }
+        else if(lo[i] == bestLo) ++loWinners;
+    }
+    double hiPot = (loWinners ? 0.5 : 1.0);
+    for(int i=0;i<np;++i) {
+        if(hi[i] == bestHi) share[i] += hiPot / hiWinners;
+        if(loWinners && lo[i] == bestLo) share[i] += 0.5 / loWinners;
+    }
+}
+
+// Exact pot share of each Omaha holding over all completions of the board;
+// every runout board is prepared once and shared by all players. With a
+// LowEvaluator the pot is split high / eight-or-better low (Omaha Hi/Lo).
+void omahaEquity(const vector<vector<int>>& holes, const int* board, int numBoard,
+                 const OmahaTables& tables, const FastEvaluator& eval, double* equity,
+                 const LowEvaluator* low = nullptr) {
+    uint64_t dead = 0;
+    for(const auto& h : holes) for(int c : h) dead |= 1ULL << cardIndex(c);
+    for(int i=0;i<numBoard;++i) dead |= 1ULL << cardIndex(board[i]);
+    vector<int> deck;
+    for(int s=0;s<4;++s) for(int r=2;r<=14;++r) {
+        int c = encodeCard(r, s);
+        if(!((dead >> cardIndex(c)) & 1)) deck.push_back(c);
+    }
+    int n = (int)deck.size(), need = 5 - numBoard, np = (int)holes.size();
+    int full[5];
+    for(int i=0;i<numBoard;++i) full[i] = board[i];
+    vector<double> share(np, 0.0);
+    vector<int> idx(np), lo(np, 0), holeLow(np, 0);
+    for(int i=0;i<np;++i) for(int c : holes[i]) holeLow[i] |= lowBit(c);
+    long long runouts = 0;
+    OmahaBoard ob;
+    int pick[5];
+    for(int k=0;k<need;++k) pick[k] = k;
+    while(true) {
+        for(int k=0;k<need;++k) full[numBoard + k] = deck[pick[k]];
+        ob.prepare(full, tables, eval);
+        for(int i=0;i<np;++i) idx[i] = ob.evaluate(holes[i].data(), (int)holes[i].size());
+        if(low) {
+            int boardLow = 0;
+            for(int k=0;k<5;++k) boardLow |= lowBit(full[k]);
+            for(int i=0;i<np;++i) lo[i] = low->omahaA5[boardLow][holeLow[i]];
+        }
+        hiLoShowdown(idx.data(), lo.data(), np, share.data());
+        ++runouts;
+        int k = need - 1;
+        while(k >= 0 && pick[k] == n - need + k) --k;
+        if(k < 0) break;
+        ++pick[k];
+        for(int j=k+1;j<need;++j) pick[j] = pick[j-1] + 1;
+    }
+    for(int i=0;i<np;++i) equity[i] = share[i] / runouts;
+}
+
+// Reference eight-or-better Omaha low: every (2 hole, 3 board) combination.
+int omahaLowBruteForce(const int* hole, int numHole, const int* board, const LowEvaluator& low) {
+    int best = 0;
+    for(int i=0;i<numHole;++i) for(int j=i+1;j<numHole;++j)
+    for(int a=0;a<5;++a) for(int b=a+1;b<5;++b) for(int c=b+1;c<5;++c) {
+        int five[5] = {hole[i], hole[j], board[a], board[b], board[c]}, mask = 0;
+        for(int k=0;k<5;++k) mask |= lowBit(five[k]);
+        if(__builtin_popcount(mask) != 5) continue;   // a paired or high card plays
+        int v = low.a5[mask];
+        if(!best || v < best) best = v;
+    }
+    return best;
+}
+
+// Mode "omaha" (and "omaha8" for Hi/Lo, eight or better):
+//   omaha bench [4|5] [boards] [holdings per board]   check against brute force and time both
+//   omaha <hole> <hole> ... [board=<cards>]            exact equity, e.g. AsKsQhJh 7c7d8c9d board=2h5h9s
+// Every hole must have the size of the first one (4 or 5 cards) and no card
+// may appear twice across the holes and the board.
+int runOmaha(const vector<string>& args, const CanonTable& table, bool hiLo) {
+    FastEvaluator eval;
+    eval.build(table);
+    OmahaTables tables;
+    tables.build(eval);
+    unique_ptr<LowEvaluator> low;
+    if(hiLo) {
+        low.reset(new LowEvaluator);
+        low->build();
+    }
+
+    if(args.empty() || args[0] == "bench") {
+        int numHole = (args.size() > 1 ? atoi(args[1].c_str()) : 4);
+        int boards = (args.size() > 2 ? atoi(args[2].c_str()) : 2000);
+        int perBoard = (args.size() > 3 ? atoi(args[3].c_str()) : 200);
+        if(numHole != 4 && numHole != 5) { cerr << "Omaha hole cards must be 4 or 5\n"; return 1; }
+        mt19937 g(12345);
+        vector<int> deals;   // per board: 5 board cards then perBoard holdings
+        for(int b=0;b<boards;++b) {
+            Deck deck;
+            deck.shuffle(g);
+            for(int k=0;k<5;++k) deals.push_back(deck.deal());
+            for(int h=0;h<perBoard;++h) {
+                // holdings share the board but are dealt independently of each other
+                for(int k=0;k<numHole;++k) swap(deck.cards[k], deck.cards[k + g() % (deck.cards.size() - k)]);
+                deals.insert(deals.end(), deck.cards.begin(), deck.cards.begin() + numHole);
+            }
+        }
+        size_t stride = 5 + (size_t)perBoard * numHole;
+        long long evals = (long long)boards * perBoard, mismatches = 0, checksumFast = 0, checksumRef = 0;
+
+        auto t0 = chrono::steady_clock::now();
+        OmahaBoard ob;
+        vector<int> fast(evals), fastLow(evals, 0);
+        for(int b=0;b<boards;++b) {
+            const int* d = &deals[b * stride];
+            ob.prepare(d, tables, eval);
+            int boardLow = 0;
+            for(int k=0;k<5;++k) boardLow |= lowBit(d[k]);
+            for(int h=0;h<perBoard;++h) {
+                const int* hole = d + 5 + h * numHole;
+                fast[(size_t)b * perBoard + h] = ob.evaluate(hole, numHole);
+                if(low) {
+                    int holeLow = 0;
+                    for(int k=0;k<numHole;++k) holeLow |= lowBit(hole[k]);
+                    fastLow[(size_t)b * perBoard + h] = low->omahaA5[boardLow][holeLow];
+                }
+            }
+        }
+        auto t1 = chrono::steady_clock::now();
+        for(int b=0;b<boards;++b) {
+            const int* d = &deals[b * stride];
+            for(int h=0;h<perBoard;++h) {
+                const int* hole = d + 5 + h * numHole;
+                int ref = omahaBruteForce(hole, numHole, d, eval);
+                int got = fast[(size_t)b * perBoard + h];
+                if(low) {
+                    // fold the low into the checksums as a second field
+                    ref = ref * 64 + omahaLowBruteForce(hole, numHole, d, *low);
+                    got = got * 64 + fastLow[(size_t)b * perBoard + h];
+                }
+                checksumRef += ref;
+                checksumFast += got;
+                if(ref != got) ++mismatches;
+            }
+        }
+        auto t2 = chrono::steady_clock::now();
+        double fastSecs = chrono::duration<double>(t1 - t0).count();
+        double refSecs = chrono::duration<double>(t2 - t1).count();
+        cout << "PLO" << numHole << (low ? " Hi/Lo" : "") << ": " << evals << " holdings on " << boards << " boards, mismatches: " << mismatches
+             << " (checksums " << checksumFast << " / " << checksumRef << ")\n";
+        cout << "Board-prepared: " << evals / fastSecs / 1e6 << " M evals/s   brute force: "
+             << evals / refSecs / 1e6 << " M evals/s   speedup: " << refSecs / fastSecs << "x\n";
+        return mismatches ? 1 : 0;
+    }
+
+    vector<vector<int>> holes;
+    vector<string> names;
+    vector<int> board;
+    uint64_t used = 0;
+    for(const string& a : args) {
+        bool isBoard = a.compare(0, 6, "board=") == 0;
+        string text = isBoard ? a.substr(6) : a;
+        vector<int> cards;
+        for(size_t i=0;i+1<text.size();i+=2) cards.push_back(parseCard(text[i], text[i+1]));
+        if(text.size() % 2 || find(cards.begin(), cards.end(), -1) != cards.end()) { cerr << "Bad cards: " << a << "\n"; return 1; }
+        for(int c : cards) {
+            uint64_t bit = 1ULL << cardIndex(c);
+            if(used & bit) { cerr << "Card used twice: " << a << "\n"; return 1; }
+            used |= bit;
+        }
+        if(isBoard) {
+            if(!board.empty() || cards.size() > 5 || cards.size() == 1 || cards.size() == 2) {
+                cerr << "Board must be given once, with 0, 3, 4 or 5 cards: " << a << "\n";
+                return 1;
+            }
+            board = cards;
+        } else {
+            if((cards.size() != 4 && cards.size() != 5) || (!holes.empty() && cards.size() != holes[0].size())) {
+                cerr << "Every hole needs " << (holes.empty() ? "4 or 5" : to_string(holes[0].size())) << " cards: " << a << "\n";
+                return 1;
+            }
+            holes.push_back(cards);
+            names.push_back(a);
+        }
+    }
+    if(holes.size() < 2) {
+        cerr << "Usage: omaha <hole> <hole> ... [board=<0, 3, 4 or 5 cards>]\n";
+        return 1;
+    }
+    if(holes.size() * holes[0].size() + 5 > 52) { cerr << "Too many holes to deal a full board\n"; return 1; }
+    auto t0 = chrono::steady_clock::now();
+    vector<double> equity(holes.size());
+    omahaEquity(holes, board.data(), (int)board.size(), tables, eval, equity.data(), low.get());
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    for(size_t i=0;i<holes.size();++i) cout << names[i] << ": " << fixed << setprecision(4) << equity[i] * 100 << "%\n";
+    cout << defaultfloat << "Time: " << secs << " s\n";
+    return 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION O — Seven-card stud
+   Each player gets two down cards and one up card on third street,
+   one up card on each of fourth to sixth street and a last down card
+   on seventh street (up to 7 players, so the deck never runs out).
+   Limit betting: everyone antes, the lowest up card (ties: clubs,
+   diamonds, hearts, spades) must bring in, and from fourth street on
+   the best showing hand acts first. Showing hands have 1..4 cards and
+   count only pairs, trips and quads, so StudUpTable ranks every such
+   rank multiset once; a lookup sorts at most four ranks. The showdown
+   uses FastEvaluator::eval7 on each player's seven cards.
+   ------------------------------------------------------------------ */
+
+const int STUD_MAX_PLAYERS = 7;
+const int STUD_ANTE = 2;
+const int STUD_BRING_IN = 5;
+const int STUD_SMALL_BET = 20;     // third and fourth street
+const int STUD_BIG_BET = 40;       // fifth to seventh street
+
+// Rank of every showing hand of 1..4 cards (1 = best four aces).
+// Indexed by the ranks sorted high to low, each stored as rank-1 (1..13)
+// in a base-14 digit, 0 for a missing card.
+struct StudUpTable {
+    vector<uint16_t> value;
+
+    static int keyOf(int r0, int r1, int r2, int r3) {
+        return ((r0 * 14 + r1) * 14 + r2) * 14 + r3;
+    }
+
+    void build() {
+        value.assign(14*14*14*14, 0);
+        // strength tuple: (pattern, ranks by count then rank, high first)
+        vector<pair<vector<int>, int>> hands;
+        for(int n=1;n<=4;++n) {
+            int r[4] = {0, 0, 0, 0};
+            function<void(int, int)> rec = [&](int pos, int maxRank) {
+                if(pos == n) {
+                    int counts[15] = {0};
+                    for(int k=0;k<n;++k) ++counts[r[k]];
+                    vector<int> order;
+                    for(int c=4;c>=1;--c) for(int rank=14;rank>=2;--rank) if(counts[rank] == c)
+                        for(int k=0;k<c;++k) order.push_back(rank);
+                    int maxCount = 0, pairs = 0;
+                    for(int rank=2;rank<=14;++rank) { maxCount = max(maxCount, counts[rank]); pairs += counts[rank] == 2; }
+                    int pattern = maxCount == 4 ? 0 : maxCount == 3 ? 1 : pairs == 2 ? 2 : pairs == 1 ? 3 : 4;
+                    vector<int> strength = {pattern};
+                    for(int x : order) strength.push_back(-x);
+                    strength.push_back(0);      // a longer hand beats its own prefix
+                    hands.push_back({strength, keyOf(r[0] - 1, n > 1 ? r[1] - 1 : 0, n > 2 ? r[2] - 1 : 0, n > 3 ? r[3] - 1 : 0)});
+                    return;
+                }
+                for(int rank=maxRank; rank>=2; --rank) {
+                    r[pos] = rank;
+                    int same = 0;
+                    for(int k=0;k<=pos;++k) same += r[k] == rank;
+                    if(same <= 4) rec(pos + 1, rank);
+                }
+            };
+            rec(0, 14);
+        }
+        sort(hands.begin(), hands.end());
+        int idx = 0;
+        for(size_t i=0;i<hands.size();++i) {
+            if(i == 0 || hands[i].first != hands[i-1].first) ++idx;
+            value[hands[i].second] = (uint16_t)idx;
+        }
+    }
+
+    // Value of n (1..4) showing cards, lower = better.
+    int eval(const int* c, int n) const {
+        int r[4] = {0, 0, 0, 0};
+        for(int k=0;k<n;++k) {
+            int x = cardRank(c[k]) - 1, j = k;
+            for(; j>0 && r[j-1] < x; --j) r[j] = r[j-1];
+            r[j] = x;
+        }
+        return value[keyOf(r[0], r[1], r[2], r[3])];
+    }
+};
+
+struct StudHand {
+    int numPlayers;
+    int down[STUD_MAX_PLAYERS][3];    // two on third street, one on seventh
+    int up[STUD_MAX_PLAYERS][4];      // third to sixth street
+    int numDown, numUp;               // dealt so far, same for every player
+    bool folded[STUD_MAX_PLAYERS];
+    int invested[STUD_MAX_PLAYERS];
+    int pot;
+    int live;
+};
+
+// Player who must bring in: lowest up card by rank, then by suit.
+int studBringIn(const StudHand& h) {
+    int best = -1;
+    for(int p=0;p<h.numPlayers;++p) {
+        int c = h.up[p][0];
+        if(best < 0 || cardRank(c) < cardRank(h.up[best][0]) ||
+           (cardRank(c) == cardRank(h.up[best][0]) && cardSuit(c) < cardSuit(h.up[best][0]))) best = p;
+    }
+    return best;
+}
+
+// Player to open fourth street onwards: best showing hand, ties to the lowest seat.
+int studFirstToAct(const StudHand& h, const StudUpTable& up) {
+    int best = -1, bestValue = INT_MAX;
+    for(int p=0;p<h.numPlayers;++p) {
+        if(h.folded[p]) continue;
+        int v = up.eval(h.up[p], h.numUp);
+        if(v < bestValue) { bestValue = v; best = p; }
+    }
+    return best;
+}
+
+// One limit betting round with random legal actions. On third street the
+// bring-in is posted first and the player after it opens; a bet there
+// "completes" to the small bet. At most MAX_RAISES bets per street.
+void studBettingRound(StudHand& h, int street, int opener, HandRng& g, bool log) {
+    int betSize = (street <= 4 ? STUD_SMALL_BET : STUD_BIG_BET);
+    int streetIn[STUD_MAX_PLAYERS] = {0};
+    int currentBet = 0, bets = 0;
+    int p = opener;
+    if(street == 3) {
+        streetIn[opener] = currentBet = STUD_BRING_IN;
+        h.invested[opener] += STUD_BRING_IN;
+        h.pot += STUD_BRING_IN;
+        if(log) cout << "Player " << opener + 1 << ": brings in for " << STUD_BRING_IN << "\n";
+        p = (opener + 1) % h.numPlayers;
+    }
+    // everyone still in must act at least once after the last bet
+    int toAct = h.live - (street == 3 ? 1 : 0);
+    while(toAct > 0 && h.live > 1) {
+        if(h.folded[p]) { p = (p + 1) % h.numPlayers; continue; }
+        Action allowed[3];
+        int n = 0;
+        if(currentBet == streetIn[p]) allowed[n++] = A_CHECK;
+        else { allowed[n++] = A_CALL; allowed[n++] = A_FOLD; }
+        if(bets < MAX_RAISES) allowed[n++] = (bets ? A_RAISE : A_BET);
+        Action a = pickRandom(allowed, n, g);
+        int pay = 0;
+        if(a == A_CALL) pay = currentBet - streetIn[p];
+        if(a == A_BET || a == A_RAISE) {
+            currentBet = (bets + 1) * betSize;
+            ++bets;
+            pay = currentBet - streetIn[p];
+            toAct = h.live;     // the others act again, this player is counted off below
+        }
+        if(a == A_FOLD) { h.folded[p] = true; --h.live; }
+        streetIn[p] += pay;
+        h.invested[p] += pay;
+        h.pot += pay;
+        --toAct;
+        if(log) {
+            cout << "Player " << p + 1 << ": " << (street == 3 && a == A_BET ? string("complete") : actionStr(a));
+            if(pay) cout << " " << pay;
+            cout << "\n";
+        }
+        p = (p + 1) % h.numPlayers;
+    }
+}
+
+struct StudStats {
+    long long hands = 0, showdowns = 0, potTotal = 0;
+};
+
+// Deal and play hand hnum of a stud run, adding it to stats (printed if log).
+void playStudHand(int numPlayers, uint64_t runSeed, int hnum, const FastEvaluator& eval,
+                  const StudUpTable& upTable, StudStats& stats, bool log) {
+    HandRng g(runSeed, (uint64_t)hnum);
+    Deck deck;
+    deck.shuffle(g);
+    StudHand h;
+    h.numPlayers = numPlayers;
+    h.numDown = h.numUp = 0;
+    h.pot = 0;
+    h.live = numPlayers;
+    for(int p=0;p<numPlayers;++p) {
+        h.folded[p] = false;
+        h.invested[p] = STUD_ANTE;
+        h.pot += STUD_ANTE;
+    }
+    if(log) cout << "\n==================================================\nSTUD HAND #" << hnum << "\n";
+    for(int street=3; street<=7 && h.live > 1; ++street) {
+        for(int p=0;p<numPlayers;++p) {
+            if(h.folded[p]) continue;
+            if(street == 3) { h.down[p][0] = deck.deal(); h.down[p][1] = deck.deal(); }
+            if(street == 7) h.down[p][2] = deck.deal();
+            else h.up[p][h.numUp] = deck.deal();
+        }
+        if(street == 3) h.numDown = 2;
+        if(street == 7) h.numDown = 3; else ++h.numUp;
+        int opener = (street == 3 ? studBringIn(h) : studFirstToAct(h, upTable));
+        if(log) {
+            cout << "\n-- " << (street == 3 ? "Third" : street == 4 ? "Fourth" : street == 5 ? "Fifth" : street == 6 ? "Sixth" : "Seventh")
+                 << " street --\n";
+            for(int p=0;p<numPlayers;++p) {
+                if(h.folded[p]) continue;
+                cout << "Player " << p + 1 << " shows:";
+                for(int k=0;k<h.numUp;++k) cout << (k ? ", " : " ") << cardToString(h.up[p][k]);
+                if(street >= 4) cout << "  (showing value " << upTable.eval(h.up[p], h.numUp) << ")";
+                cout << "\n";
+            }
+        }
+        studBettingRound(h, street, opener, g, log);
+    }
+
+    ++stats.hands;
+    stats.potTotal += h.pot;
+    int idx[STUD_MAX_PLAYERS], best = INT_MAX, winners = 0;
+    for(int p=0;p<numPlayers;++p) {
+        idx[p] = INT_MAX;
+        if(h.folded[p] || h.live == 1) continue;
+        int seven[7] = {h.down[p][0], h.down[p][1], h.up[p][0], h.up[p][1], h.up[p][2], h.up[p][3], h.down[p][2]};
+        idx[p] = eval.eval7(seven);
+        if(idx[p] < best) { best = idx[p]; winners = 1; }
+        else if(idx[p] == best) ++winners;
+    }
+    if(h.live > 1) ++stats.showdowns;
+    if(!log) return;
+    cout << "\n-- Result --\n";
+    for(int p=0;p<numPlayers;++p) {
+        if(h.folded[p]) continue;
+        if(h.live == 1) { cout << "Player " << p + 1 << " wins " << h.pot << " uncontested\n"; continue; }
+        cout << "Player " << p + 1 << ": " << categoryName(eval.categoryOf[idx[p]]) << " (index " << idx[p] << ")";
+        if(idx[p] == best) cout << "  wins " << h.pot / winners;
+        cout << "\n";
+    }
+}
+
+// Mode "stud": play seeded stud hands with random actions; prints the
+// first hand in full and a summary.
+int runStud(int numHands, int numPlayers, const CanonTable& table) {
+    numPlayers = max(2, min(numPlayers, STUD_MAX_PLAYERS));
+    FastEvaluator eval;
+    eval.build(table);
+    StudUpTable upTable;
+    upTable.build();
+    uint64_t runSeed = ((uint64_t)rd() << 32) ^ rd();
+    cout << "Run seed: " << runSeed << "\n";
+    StudStats stats;
+    auto t0 = chrono::steady_clock::now();
+    for(int n=1;n<=numHands;++n) playStudHand(numPlayers, runSeed, n, eval, upTable, stats, n == 1);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << "\nStud hands: " << stats.hands << " (" << numPlayers << " players)  showdowns: " << stats.showdowns
+         << "  average pot: " << (double)stats.potTotal / max(1LL, stats.hands)
+         << "  hands/s: " << stats.hands / secs << "\n";
+    return 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION P — Exact category probabilities
+   "How likely am I to finish with a flush?" needs only the category
+   of the final 7-card hand, never its kickers. The category follows
+   from the four per-suit rank masks: their bitwise combinations give
+   the ranks held 2+, 3+ and 4 times, a flush is a suit with 5+ ranks
+   and straights come from a 13-bit lookup. Enumerating every runout
+   with these masks costs a few bit operations per runout. Results are
+   cached by the known cards up to suit relabeling, and big
+   enumerations (few known cards) are split across threads by the
+   first dealt card. Standard 52-card rules.
+   ------------------------------------------------------------------ */
+
+struct CategoryOdds {
+    double p[10];          // p[category], categories 1..9 (p[0] unused)
+    long long runouts;
+};
+
+struct CategoryCalculator {
+    uint8_t straightTop[8192];          // rank mask -> straight top rank, 0 = none
+    uint8_t rankCount[8192];            // rank mask -> ranks set (no popcnt instruction at -O2)
+    mutex cacheLock;
+    unordered_map<uint64_t, CategoryOdds> cache;
+
+    void build() {
+        for(int m=0;m<8192;++m) {
+            straightTop[m] = (uint8_t)detectStraightTop(m);
+            rankCount[m] = (uint8_t)__builtin_popcount(m);
+        }
+    }
+
+    // Category of the best hand held in the suit masks (bit r-2 of s[suit] = card held).
+    int category(const int* s) const {
+        int ranks = s[0] | s[1] | s[2] | s[3];
+        int two = (s[0] & s[1]) | (s[0] & s[2]) | (s[0] & s[3]) | (s[1] & s[2]) | (s[1] & s[3]) | (s[2] & s[3]);
+        int three = (s[0] & s[1] & (s[2] | s[3])) | (s[2] & s[3] & (s[0] | s[1]));
+        int four = s[0] & s[1] & s[2] & s[3];
+        int flushMask = 0;
+        for(int k=0;k<4;++k) if(rankCount[s[k]] >= 5) flushMask = s[k];
+        if(flushMask && straightTop[flushMask]) return CAT_STRAIGHT_FLUSH;
+        if(four) return CAT_FOUR_KIND;
+        if(three && (rankCount[three] >= 2 || (two & ~three))) return CAT_FULL_HOUSE;
+        if(flushMask) return CAT_FLUSH;
+        if(straightTop[ranks]) return CAT_STRAIGHT;
+        if(three) return CAT_THREE_KIND;
+        if(rankCount[two] >= 2) return CAT_TWO_PAIR;
+        if(two) return CAT_ONE_PAIR;
+        return CAT_HIGH_CARD;
+    }
+
+    // Smallest 52-bit card set over the 24 suit relabelings.
+    static uint64_t canonicalKey(uint64_t cards) {
+        int perm[4] = {0, 1, 2, 3};
+        uint64_t best = ~0ULL;
+        do {
+            uint64_t key = 0;
+            for(int s=0;s<4;++s) key |= ((cards >> (13*s)) & 0x1FFF) << (13*perm[s]);
+            best = min(best, key);
+        } while(next_permutation(perm, perm + 4));
+        return best;
+    }
+
+    // Count the final categories of every completion of the known cards
+    // (given as suit masks) by `need` more cards from deck[from..n).
+    void enumerate(int* s, const int* deck, int n, int from, int need, long long* counts) const {
+        if(need == 0) { ++counts[category(s)]; return; }
+        for(int i=from;i<=n-need;++i) {
+            int suit = deck[i] / 13, bit = 1 << (deck[i] % 13);
+            s[suit] |= bit;
+            enumerate(s, deck, n, i + 1, need - 1, counts);
+            s[suit] &= ~bit;
+        }
+    }
+
+    // Probability of each category for the final 7-card hand, given
+    // numKnown (0..7) distinct known cards (hole and board together).
+    CategoryOdds odds(const int* known, int numKnown, int threads) {
+        uint64_t cards = 0;
+        for(int i=0;i<numKnown;++i) cards |= 1ULL << cardIndex(known[i]);
+        uint64_t key = canonicalKey(cards);
+        {
+            lock_guard<mutex> lk(cacheLock);
+            auto it = cache.find(key);
+            if(it != cache.end()) return it->second;
+        }
+        int s[4] = {0, 0, 0, 0};
+        for(int i=0;i<numKnown;++i) s[cardSuit(known[i])] |= 1 << (cardRank(known[i]) - 2);
+        int deck[52], n = 0;
+        for(int c=0;c<52;++c) if(!((cards >> c) & 1)) deck[n++] = c;
+        int need = 7 - numKnown;
+
+        long long counts[10] = {0};
+        if(need <= 2) {
+            enumerate(s, deck, n, 0, need, counts);
+        } else {
+            // one task per first dealt card; the rest is dealt from the cards after it
+            int tasks = n - need + 1;
+            vector<array<long long, 10>> partial(tasks);
+            parallelFor(tasks, threads, [&](int i) {
+                int local[4] = {s[0], s[1], s[2], s[3]};
+                local[deck[i] / 13] |= 1 << (deck[i] % 13);
+                partial[i].fill(0);
+                enumerate(local, deck, n, i + 1, need - 1, partial[i].data());
+            });
+            for(auto& p : partial) for(int c=0;c<10;++c) counts[c] += p[c];
+        }
+        CategoryOdds result;
+        result.runouts = 0;
+        for(int c=0;c<10;++c) result.runouts += counts[c];
+        for(int c=0;c<10;++c) result.p[c] = (double)counts[c] / result.runouts;
+        lock_guard<mutex> lk(cacheLock);
+        cache.emplace(key, result);
+        return result;
+    }
+};
+
+// Mode "categories":
+//   categories <cards> [cards...]   e.g. "AhKh Qh7h2c": final-category odds by the river
+//   categories check [hands]         category path vs FastEvaluator on random 7-card hands
+int runCategoryOdds(const vector<string>& args, const CanonTable& table) {
+    CategoryCalculator calc;
+    calc.build();
+    int threads = max(1u, thread::hardware_concurrency());
+
+    if(!args.empty() && args[0] == "check") {
+        int hands = (args.size() > 1 ? atoi(args[1].c_str()) : 1000000);
+        FastEvaluator eval;
+        eval.build(table);
+        mt19937 g(99);
+        Deck deck;
+        long long mismatches = 0;
+        for(int n=0;n<hands;++n) {
+            for(int k=0;k<7;++k) swap(deck.cards[k], deck.cards[k + g() % (52 - k)]);
+            int s[4] = {0, 0, 0, 0};
+            for(int k=0;k<7;++k) s[cardSuit(deck.cards[k])] |= 1 << (cardRank(deck.cards[k]) - 2);
+            if(calc.category(s) != eval.categoryOf[eval.eval7(deck.cards.data())]) ++mismatches;
+        }
+        cout << "Hands: " << hands << "  category mismatches: " << mismatches << "\n";
+        return mismatches ? 1 : 0;
+    }
+
+    vector<int> known;
+    for(const string& a : args) for(size_t i=0;i+1<a.size();i+=2) known.push_back(parseCard(a[i], a[i+1]));
+    uint64_t seen = 0;
+    for(int c : known) {
+        if(c < 0 || ((seen >> cardIndex(c)) & 1)) { cerr << "Bad or repeated card\n"; return 1; }
+        seen |= 1ULL << cardIndex(c);
+    }
+    if(known.size() > 7) { cerr << "At most 7 known cards\n"; return 1; }
+
+    auto t0 = chrono::steady_clock::now();
+    CategoryOdds odds = calc.odds(known.data(), (int)known.size(), threads);
+    auto t1 = chrono::steady_clock::now();
+    calc.odds(known.data(), (int)known.size(), threads);
+    auto t2 = chrono::steady_clock::now();
+    cout << "Runouts: " << odds.runouts << "\n";
+    for(int cat=1; cat<=9; ++cat)
+        cout << "  " << left << setw(16) << categoryName(cat) << right << fixed << setprecision(4)
+             << setw(9) << odds.p[cat] * 100 << "%\n";
+    cout << defaultfloat << "Time: " << chrono::duration<double, micro>(t1 - t0).count() << " us  (cached: "
+         << chrono::duration<double, micro>(t2 - t1).count() << " us)\n";
+    return 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION Q — Outs and draws
+   For hole cards on a flop or turn, DrawAnalyzer lists every unseen
+   card that improves the hand's category (grouped by the category it
+   makes), the straight/flush draws held, and which outs also help
+   other players. Everything works on the same 13-bit rank masks as
+   detectStraightTop, through three tables filled once:
+   - completes[mask]  ranks that turn the mask into a straight
+   - windows[mask]    straight windows (one bit per top card, wheel
+                      first) holding at least 3 of the ranks
+   plus the category function of Section P for each candidate card.
+   An out must improve on what the board alone makes with that card
+   (pairing the board is not our out). An out "helps the opponent"
+   when it pairs the board, brings a third card of a suit to the board
+   or opens a new straight window on the board.
+   ------------------------------------------------------------------ */
+
+enum DrawFlag {
+    DRAW_FLUSH             = 1,    // four to a flush using a hole card
+    DRAW_OPEN_ENDED        = 2,    // two or more straight ranks (open-ender, double gutter)
+    DRAW_GUTSHOT           = 4,    // exactly one straight rank
+    DRAW_BACKDOOR_FLUSH    = 8,    // flop: three to a flush using a hole card
+    DRAW_BACKDOOR_STRAIGHT = 16    // flop: three in a straight window using a hole card
+};
+
+struct DrawInfo {
+    int category;               // category now
+    uint64_t outs[10];          // cards (bit cardIndex) that improve us to category c
+    uint64_t allOuts;
+    uint64_t sharedOuts;        // outs that also help other players
+    int numOuts;
+    int flags;                  // DrawFlag bits
+};
+
+struct DrawAnalyzer {
+    uint16_t completes[8192];
+    uint16_t windows[8192];
+    CategoryCalculator categories;
+
+    void build() {
+        categories.build();
+        for(int m=0;m<8192;++m) {
+            completes[m] = 0;
+            if(!detectStraightTop(m))
+                for(int r=0;r<13;++r) if(!((m >> r) & 1) && detectStraightTop(m | (1 << r))) completes[m] |= 1 << r;
+            windows[m] = 0;
+            int wheel = (1 << 12) | 0xF;
+            if(__builtin_popcount(m & wheel) >= 3) windows[m] |= 1;
+            for(int top=6; top<=14; ++top)
+                if(__builtin_popcount(m & (0x1F << (top - 6))) >= 3) windows[m] |= 1 << (top - 5);
+        }
+    }
+
+    // hole: 2 cards, board: 3 or 4 cards
+    void analyze(const int* hole, const int* board, int numBoard, DrawInfo& out) const {
+        int all[4] = {0, 0, 0, 0}, onBoard[4] = {0, 0, 0, 0};
+        uint64_t seen = 0;
+        for(int i=0;i<2;++i) { all[cardSuit(hole[i])] |= 1 << (cardRank(hole[i]) - 2); seen |= 1ULL << cardIndex(hole[i]); }
+        for(int i=0;i<numBoard;++i) {
+            int s = cardSuit(board[i]), bit = 1 << (cardRank(board[i]) - 2);
+            all[s] |= bit;
+            onBoard[s] |= bit;
+            seen |= 1ULL << cardIndex(board[i]);
+        }
+        int ranks = all[0] | all[1] | all[2] | all[3];
+        int boardRanks = onBoard[0] | onBoard[1] | onBoard[2] | onBoard[3];
+        out.category = categories.category(all);
+        memset(out.outs, 0, sizeof(out.outs));
+        out.allOuts = out.sharedOuts = 0;
+
+        const uint8_t* count = categories.rankCount;
+        int flushSuits = 0;   // suits where one more card makes five
+        for(int s=0;s<4;++s) if(count[all[s]] >= 4) flushSuits |= 1 << s;
+        // only pairing a rank, completing a straight or a flush can change the category
+        uint64_t candidateRanks = (uint64_t)(ranks | completes[ranks]), unseen = 0;
+        for(int s=0;s<4;++s) unseen |= (((flushSuits >> s) & 1) ? 0x1FFFULL : candidateRanks) << (13*s);
+        unseen &= ~seen;
+        for(; unseen; unseen &= unseen - 1) {
+            int c = __builtin_ctzll(unseen);
+            int s = c / 13, bit = 1 << (c % 13);
+            all[s] |= bit;
+            int mine = categories.category(all);
+            all[s] &= ~bit;
+            if(mine >= out.category) continue;
+            onBoard[s] |= bit;
+            int boardOnly = categories.category(onBoard);
+            onBoard[s] &= ~bit;
+            if(mine >= boardOnly) continue;
+            out.outs[mine] |= 1ULL << c;
+            out.allOuts |= 1ULL << c;
+            bool pairsBoard = (boardRanks & bit) != 0;
+            bool suitsBoard = count[onBoard[s]] == 2;
+            bool opensStraight = (windows[boardRanks | bit] & ~windows[boardRanks]) != 0;
+            if(pairsBoard || suitsBoard || opensStraight) out.sharedOuts |= 1ULL << c;
+        }
+        out.numOuts = __builtin_popcountll(out.allOuts);
+
+        out.flags = 0;
+        bool madeStraight = categories.straightTop[ranks] != 0;
+        for(int s=0;s<4;++s) {
+            int holeInSuit = (cardSuit(hole[0]) == s) + (cardSuit(hole[1]) == s);
+            int n = count[all[s]];
+            if(!holeInSuit) continue;
+            if(n == 4) out.flags |= DRAW_FLUSH;
+            if(n == 3 && numBoard == 3) out.flags |= DRAW_BACKDOOR_FLUSH;
+        }
+        if(!madeStraight) {
+            // straight ranks that need our hole cards
+            int draw = completes[ranks] & ~completes[boardRanks];
+            if(count[draw] >= 2) out.flags |= DRAW_OPEN_ENDED;
+            else if(draw) out.flags |= DRAW_GUTSHOT;
+            if(!draw && numBoard == 3 && (windows[ranks] & ~windows[boardRanks])) out.flags |= DRAW_BACKDOOR_STRAIGHT;
+        }
+    }
+};
+
+// Mode "draws":
+//   draws <hole> <board>    e.g. "draws 9h8h Th7c2h" lists the outs by category
+//   draws bench [count]      analyses per second on random flops and turns
+int runDraws(const vector<string>& args) {
+    DrawAnalyzer analyzer;
+    analyzer.build();
+
+    if(args.empty() || args[0] == "bench") {
+        int count = (args.size() > 1 ? atoi(args[1].c_str()) : 2000000);
+        mt19937 g(7);
+        Deck deck;
+        vector<int> deals;
+        const int dealsPerRun = 4096;
+        for(int n=0;n<dealsPerRun;++n) {
+            for(int k=0;k<6;++k) swap(deck.cards[k], deck.cards[k + g() % (52 - k)]);
+            deals.insert(deals.end(), deck.cards.begin(), deck.cards.begin() + 6);
+        }
+        long long checksum = 0;
+        DrawInfo info;
+        auto t0 = chrono::steady_clock::now();
+        for(int n=0;n<count;++n) {
+            const int* d = &deals[(n % dealsPerRun) * 6];
+            analyzer.analyze(d, d + 2, 3 + (n & 1), info);
+            checksum += info.numOuts + info.flags;
+        }
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        cout << "Analyses: " << count << "  " << count / secs / 1e6 << " M/s  (checksum " << checksum << ")\n";
+        return 0;
+    }
+
+    vector<int> cards;
+    for(const string& a : args) for(size_t i=0;i+1<a.size();i+=2) cards.push_back(parseCard(a[i], a[i+1]));
+    uint64_t seen = 0;
+    for(int c : cards) {
+        if(c < 0 || ((seen >> cardIndex(c)) & 1)) { cerr << "Bad or repeated card\n"; return 1; }
+        seen |= 1ULL << cardIndex(c);
+    }
+    if(cards.size() != 5 && cards.size() != 6) { cerr << "Usage: draws <hole> <flop or turn board>\n"; return 1; }
+    DrawInfo info;
+    analyzer.analyze(cards.data(), cards.data() + 2, (int)cards.size() - 2, info);
+    auto cardList = [](uint64_t mask) {
+        string s;
+        for(int c=0;c<52;++c) if((mask >> c) & 1) {
+            if(!s.empty()) s += ' ';
+            s += cardShortString(COMBOS.encoded[c]);
+        }
+        return s;
+    };
+    cout << "Now: " << categoryName(info.category) << "\n";
+    static const char* flagNames[] = {"flush draw", "open-ended", "gutshot", "backdoor flush", "backdoor straight"};
+    cout << "Draws:";
+    for(int k=0;k<5;++k) if(info.flags & (1 << k)) cout << " [" << flagNames[k] << "]";
+    cout << (info.flags ? "\n" : " none\n");
+    for(int cat=1; cat<=9; ++cat) if(info.outs[cat])
+        cout << "  " << left << setw(16) << categoryName(cat) << right << setw(3) << __builtin_popcountll(info.outs[cat])
+             << "  " << cardList(info.outs[cat]) << "\n";
+    cout << "Outs: " << info.numOuts << "  also help others: " << __builtin_popcountll(info.sharedOuts)
+         << "  (" << cardList(info.sharedOuts) << ")\n";
+    return 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION R — Board texture and nut hands
+   Every flop, turn and river is mapped to its suit-canonical board
+   (the smallest card set over the 24 suit relabelings). For each
+   canonical board we store, once:
+   - a texture descriptor: paired / trips, rainbow / two-tone /
+     monotone, connected, straight and flush possibilities
+   - the nut hand index (best index any two hole cards make now)
+     and the hole-card combos that make it, in canonical suits
+   A raw board is found by the colex rank of its card indices, which
+   addresses a per-size table holding (canonical id, suit relabeling),
+   so a query is a few adds and two array reads. Nut combos are mapped
+   back to the board's own suits through the stored relabeling.
+   ------------------------------------------------------------------ */
+
+enum TextureFlag {
+    TEX_PAIRED            = 1,
+    TEX_TWO_PAIR          = 2,
+    TEX_TRIPS             = 4,      // three or four of a rank
+    TEX_RAINBOW           = 8,      // no two cards share a suit
+    TEX_TWO_TONE          = 16,     // at most two of any suit, not rainbow
+    TEX_MONOTONE          = 32,     // all one suit
+    TEX_FLUSH_POSSIBLE    = 64,     // three or more of a suit
+    TEX_FOUR_FLUSH        = 128,    // four or more of a suit
+    TEX_CONNECTED         = 256,    // two adjacent ranks (A-2 counts)
+    TEX_STRAIGHT_POSSIBLE = 512,    // a straight window holds three board ranks
+    TEX_FOUR_STRAIGHT     = 1024    // a straight window holds four board ranks
+};
+
+struct BoardInfo {
+    uint16_t flags;         // TextureFlag bits
+    uint8_t highRank;       // 2..14
+    uint8_t maxSuit;        // most cards of one suit
+    uint16_t nutIndex;      // 1..7462
+    uint16_t numNutCombos;
+    uint32_t nutOffset;     // into BoardTextureTable::nutCombos
+};
+
+const int SUIT_PERMS[24][4] = {
+    {0,1,2,3},{0,1,3,2},{0,2,1,3},{0,2,3,1},{0,3,1,2},{0,3,2,1},
+    {1,0,2,3},{1,0,3,2},{1,2,0,3},{1,2,3,0},{1,3,0,2},{1,3,2,0},
+    {2,0,1,3},{2,0,3,1},{2,1,0,3},{2,1,3,0},{2,3,0,1},{2,3,1,0},
+    {3,0,1,2},{3,0,2,1},{3,1,0,2},{3,1,2,0},{3,2,0,1},{3,2,1,0}};
+
+struct BoardTextureTable {
+    // per board size 3..5
+    vector<uint32_t> rawToEntry[6];     // colex rank -> canonical id << 5 | suit permutation
+    vector<BoardInfo> info[6];          // by canonical id
+    vector<uint16_t> nutCombos[6];      // COMBOS indices in canonical suits
+    uint32_t binom[53][6];
+
+    static uint64_t relabel(uint64_t cards, int perm) {
+        uint64_t key = 0;
+        for(int s=0;s<4;++s) key |= ((cards >> (13*s)) & 0x1FFF) << (13*SUIT_PERMS[perm][s]);
+        return key;
+    }
+
+    uint32_t colexRank(const int* sortedIdx, int n) const {
+        uint32_t r = 0;
+        for(int i=0;i<n;++i) r += binom[sortedIdx[i]][i+1];
+        return r;
+    }
+
+    void build(const FastEvaluator& eval, const NoFlush7Table& noFlush, int threads) {
+        for(int n=0;n<=52;++n) for(int k=0;k<6;++k)
+            binom[n][k] = (k == 0 ? 1 : n == 0 ? 0 : binom[n-1][k-1] + binom[n-1][k]);
+        for(int size=3; size<=5; ++size) buildSize(size, eval, noFlush, threads);
+    }
+
+    void buildSize(int size, const FastEvaluator& eval, const NoFlush7Table& noFlush, int threads) {
+        rawToEntry[size].assign(binom[52][size], 0);
+        unordered_map<uint64_t, uint32_t> ids;
+        vector<uint64_t> keys;
+        int idx[5];
+        function<void(int, int)> rec = [&](int pos, int from) {
+            if(pos == size) {
+                uint64_t cards = 0;
+                for(int i=0;i<size;++i) cards |= 1ULL << idx[i];
+                uint64_t best = ~0ULL;
+                int bestPerm = 0;
+                for(int p=0;p<24;++p) {
+                    uint64_t key = relabel(cards, p);
+                    if(key < best) { best = key; bestPerm = p; }
+                }
+                auto it = ids.emplace(best, (uint32_t)keys.size()).first;
+                if(it->second == keys.size()) keys.push_back(best);
+                rawToEntry[size][colexRank(idx, size)] = it->second << 5 | bestPerm;
+                return;
+            }
+            for(int c=from;c<52;++c) { idx[pos] = c; rec(pos + 1, c + 1); }
+        };
+        rec(0, 0);
+
+        info[size].assign(keys.size(), BoardInfo());
+        vector<vector<uint16_t>> nuts(keys.size());
+        parallelFor((int)keys.size(), threads, [&](int id) {
+            int board[5], n = 0;
+            for(int c=0;c<52;++c) if((keys[id] >> c) & 1) board[n++] = COMBOS.encoded[c];
+            describe(board, size, info[size][id]);
+            int cards[7];
+            for(int i=0;i<size;++i) cards[i+2] = board[i];
+            int best = INT_MAX;
+            for(int h=0;h<NUM_COMBOS;++h) {
+                int a = COMBOS.cards[h][0], b = COMBOS.cards[h][1];
+                if((keys[id] >> a) & 1 || (keys[id] >> b) & 1) continue;
+                cards[0] = COMBOS.encoded[a];
+                cards[1] = COMBOS.encoded[b];
+                int v;
+                if(size == 3) v = eval.eval5(cards[0], cards[1], cards[2], cards[3], cards[4]);
+                else if(size == 5) v = noFlush.eval7(cards, eval);
+                else {
+                    v = INT_MAX;
+                    for(int skip=0; skip<6; ++skip) {
+                        int five[5], m = 0;
+                        for(int i=0;i<6;++i) if(i != skip) five[m++] = cards[i];
+                        v = min(v, eval.eval5(five[0], five[1], five[2], five[3], five[4]));
+                    }
+                }
+                if(v < best) { best = v; nuts[id].clear(); }
+                if(v == best) nuts[id].push_back((uint16_t)h);
+            }
+            info[size][id].nutIndex = (uint16_t)best;
+            info[size][id].numNutCombos = (uint16_t)nuts[id].size();
+        });
+        nutCombos[size].clear();
+        for(size_t id=0; id<keys.size(); ++id) {
+            info[size][id].nutOffset = (uint32_t)nutCombos[size].size();
+            nutCombos[size].insert(nutCombos[size].end(), nuts[id].begin(), nuts[id].end());
+        }
+    }
+
+    static void describe(const int* board, int n, BoardInfo& out) {
+        int counts[15] = {0}, suits[4] = {0}, ranks = 0;
+        out.highRank = 0;
+        for(int i=0;i<n;++i) {
+            ++counts[cardRank(board[i])];
+            ++suits[cardSuit(board[i])];
+            ranks |= 1 << (cardRank(board[i]) - 2);
+            out.highRank = (uint8_t)max((int)out.highRank, cardRank(board[i]));
+        }
+        int pairs = 0, trips = 0;
+        for(int r=2;r<=14;++r) { pairs += counts[r] == 2; trips += counts[r] >= 3; }
+        out.maxSuit = (uint8_t)*max_element(suits, suits + 4);
+        int f = 0;
+        if(pairs) f |= TEX_PAIRED;
+        if(pairs >= 2) f |= TEX_TWO_PAIR;
+        if(trips) f |= TEX_TRIPS | TEX_PAIRED;
+        if(out.maxSuit == 1) f |= TEX_RAINBOW;
+        if(out.maxSuit == 2) f |= TEX_TWO_TONE;
+        if(out.maxSuit == n) f |= TEX_MONOTONE;
+        if(out.maxSuit >= 3) f |= TEX_FLUSH_POSSIBLE;
+        if(out.maxSuit >= 4) f |= TEX_FOUR_FLUSH;
+        int withLowAce = ranks << 1 | (ranks >> 12);    // bit 0 = ace as one
+        if(withLowAce & (withLowAce >> 1)) f |= TEX_CONNECTED;
+        for(int low=0; low<=9; ++low) {
+            int inWindow = __builtin_popcount((withLowAce >> low) & 0x1F);
+            if(inWindow >= 3) f |= TEX_STRAIGHT_POSSIBLE;
+            if(inWindow >= 4) f |= TEX_FOUR_STRAIGHT;
+        }
+        out.flags = (uint16_t)f;
+    }
+
+    // Descriptor of a 3..5 card board. perm (optional) receives the suit
+    // relabeling from the board's suits to the canonical ones.
+    const BoardInfo& lookup(const int* board, int n, int* perm = nullptr) const {
+        int idx[5];
+        for(int i=0;i<n;++i) {
+            int c = cardIndex(board[i]), j = i;
+            for(; j>0 && idx[j-1] > c; --j) idx[j] = idx[j-1];
+            idx[j] = c;
+        }
+        uint32_t entry = rawToEntry[n][colexRank(idx, n)];
+        if(perm) *perm = entry & 31;
+        return info[n][entry >> 5];
+    }
+
+    // Nut hole-card combos (COMBOS indices) in the board's own suits.
+    void nutHands(const int* board, int n, vector<int>& out) const {
+        int perm;
+        const BoardInfo& bi = lookup(board, n, &perm);
+        int inverse[4];
+        for(int s=0;s<4;++s) inverse[SUIT_PERMS[perm][s]] = s;
+        out.clear();
+        for(int k=0;k<bi.numNutCombos;++k) {
+            int h = nutCombos[n][bi.nutOffset + k];
+            int a = COMBOS.cards[h][0], b = COMBOS.cards[h][1];
+            a = inverse[a / 13] * 13 + a % 13;
+            b = inverse[b / 13] * 13 + b % 13;
+            out.push_back(COMBOS.index[a][b]);
+        }
+    }
+};
+
+// Mode "texture": build the tables, then describe the given board
+// (e.g. "texture Ah7h2c") and check nut indices against rankBoard.
+int runTexture(const vector<string>& args, const CanonTable& table) {
+    FastEvaluator eval;
+    eval.build(table);
+    NoFlush7Table noFlush;
+    noFlush.build(eval);
+    BoardTextureTable tex;
+    int threads = max(1u, thread::hardware_concurrency());
+    auto t0 = chrono::steady_clock::now();
+    tex.build(eval, noFlush, threads);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    size_t bytes = 0;
+    for(int n=3;n<=5;++n)
+        bytes += tex.rawToEntry[n].size() * 4 + tex.info[n].size() * sizeof(BoardInfo) + tex.nutCombos[n].size() * 2;
+    cout << "Canonical boards: flop " << tex.info[3].size() << ", turn " << tex.info[4].size() << ", river "
+         << tex.info[5].size() << "  (" << bytes / 1048576.0 << " MB, built in " << secs << " s)\n";
+
+    // river nuts against the showdown ranking used by the solver
+    mt19937 g(5);
+    Deck deck;
+    long long mismatches = 0, lookups = 0, checksum = 0;
+    BoardRanking ranking;
+    vector<int> nutList;
+    for(int n=0;n<2000;++n) {
+        for(int k=0;k<5;++k) swap(deck.cards[k], deck.cards[k + g() % (52 - k)]);
+        rankBoard(eval, deck.cards.data(), ranking);
+        int best = ranking.strength[ranking.order.back()];
+        int count = 0;
+        for(int h : ranking.order) count += ranking.strength[h] == best;
+        tex.nutHands(deck.cards.data(), 5, nutList);
+        bool ok = tex.lookup(deck.cards.data(), 5).nutIndex == best && (int)nutList.size() == count;
+        for(int h : nutList) ok = ok && ranking.strength[h] == best;
+        if(!ok) ++mismatches;
+    }
+    auto t1 = chrono::steady_clock::now();
+    for(int n=0;n<4000000;++n) {
+        if((n & 1023) == 0) for(int k=0;k<5;++k) swap(deck.cards[k], deck.cards[k + g() % (52 - k)]);
+        const BoardInfo& bi = tex.lookup(deck.cards.data(), 3 + n % 3);
+        checksum += bi.flags + bi.nutIndex;
+        ++lookups;
+    }
+    double lookupSecs = chrono::duration<double>(chrono::steady_clock::now() - t1).count();
+    cout << "River nut check: 2000 boards, mismatches: " << mismatches << "\n";
+    cout << "Lookups: " << lookups / lookupSecs / 1e6 << " M/s  (checksum " << checksum << ")\n";
+
+    if(args.empty()) return mismatches ? 1 : 0;
+    vector<int> board;
+    for(const string& a : args) for(size_t i=0;i+1<a.size();i+=2) board.push_back(parseCard(a[i], a[i+1]));
+    if(board.size() < 3 || board.size() > 5 || find(board.begin(), board.end(), -1) != board.end()) {
+        cerr << "Board must be 3 to 5 cards\n";
+        return 1;
+    }
+    const BoardInfo& bi = tex.lookup(board.data(), (int)board.size());
+    static const char* flagNames[] = {"paired", "two pair", "trips", "rainbow", "two-tone", "monotone",
+                                      "flush possible", "four flush", "connected", "straight possible", "four straight"};
+    cout << "Texture:";
+    for(int k=0;k<11;++k) if(bi.flags & (1 << k)) cout << " [" << flagNames[k] << "]";
+    cout << "\nNuts: " << categoryName(eval.categoryOf[bi.nutIndex]) << " (index " << bi.nutIndex << "), "
+         << bi.numNutCombos << " combos:";
+    tex.nutHands(board.data(), (int)board.size(), nutList);
+    for(size_t k=0;k<nutList.size() && k<24;++k) {
+        int a = COMBOS.cards[nutList[k]][0], b = COMBOS.cards[nutList[k]][1];
+        cout << " " << cardShortString(COMBOS.encoded[a]) << cardShortString(COMBOS.encoded[b]);
+    }
+    cout << (nutList.size() > 24 ? " ...\n" : "\n");
+    return mismatches ? 1 : 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION S — Monte Carlo equity over weighted ranges
+   Ranges are the usual 1326 combo weights (as in Section J). Each
+   range gets a Vose alias table over its combos that survive the
+   board, so a sample costs one generator draw and one compare with
+   no rejection against the known cards. In multi-way spots players
+   can still collide with each other: RangeSampler draws every player
+   independently and throws the whole deal away on any shared card
+   (redrawing only the colliding player would bias the deal towards
+   combos that block little). The narrowest range goes first so a bad
+   deal is rejected early. Board cards are then dealt from the Deck of
+   live cards, skipping the sampled hole cards.
+   ------------------------------------------------------------------ */
+
+// Parse a range such as "QQ+,AKs,AJo+,KQ,AhKh:0.5,T9s:0.25" into combo weights.
+// Tokens: pair ("TT", "TT+"), suited/offsuit/any two ranks ("AKs", "ATo+",
+// "KQ"; "+" raises the second rank up to below the first), or an exact combo
+// ("AhKh"); ":w" sets the weight (default 1). Returns false on a bad token.
+bool parseRange(const string& text, vector<float>& weights) {
+    weights.assign(NUM_COMBOS, 0.0f);
+    auto rankOf = [](char c) {
+        const char* p = strchr(RANK_CHARS, toupper((unsigned char)c));
+        return (c && p) ? (int)(p - RANK_CHARS) : -1;     // 0..12
+    };
+    stringstream ss(text);
+    string tok;
+    while(getline(ss, tok, ',')) {
+        float w = 1.0f;
+        size_t colon = tok.find(':');
+        if(colon != string::npos) { w = (float)atof(tok.c_str() + colon + 1); tok = tok.substr(0, colon); }
+        if(tok.size() == 4 && parseCard(tok[0], tok[1]) >= 0 && parseCard(tok[2], tok[3]) >= 0) {
+            int a = cardIndex(parseCard(tok[0], tok[1])), b = cardIndex(parseCard(tok[2], tok[3]));
+            if(a == b) return false;
+            weights[COMBOS.index[a][b]] = w;
+            continue;
+        }
+        bool plus = !tok.empty() && tok.back() == '+';
+        if(plus) tok.pop_back();
+        if(tok.size() < 2 || tok.size() > 3) return false;
+        int r1 = rankOf(tok[0]), r2 = rankOf(tok[1]);
+        char kind = (tok.size() == 3 ? (char)tolower((unsigned char)tok[2]) : 0);
+        if(r1 < 0 || r2 < 0 || (kind && kind != 's' && kind != 'o') || (r1 == r2 && kind)) return false;
+        if(r1 < r2) swap(r1, r2);
+        int hiEnd = (r1 == r2 ? (plus ? 12 : r1) : r1);
+        int loEnd = (r1 == r2 ? hiEnd : (plus ? r1 - 1 : r2));
+        for(int hi=r1; hi<=hiEnd; ++hi) for(int lo=(r1 == r2 ? hi : r2); lo<=(r1 == r2 ? hi : loEnd); ++lo)
+            for(int s1=0;s1<4;++s1) for(int s2=0;s2<4;++s2) {
+                int a = s1*13 + hi, b = s2*13 + lo;
+                if(a == b || (hi == lo && s1 >= s2)) continue;
+                if((kind == 's' && s1 != s2) || (kind == 'o' && s1 == s2)) continue;
+                weights[COMBOS.index[a][b]] = w;
+            }
+    }
+    return true;
+}
+
+inline uint64_t comboMask(int h) { return (1ULL << COMBOS.cards[h][0]) | (1ULL << COMBOS.cards[h][1]); }
+
+// Vose alias table over the combos of one range with positive weight
+// and no dead card. Slot from the high half of a draw, coin from the low half.
+struct AliasTable {
+    vector<uint16_t> combo;
+    vector<uint16_t> alias;         // slot to use when the coin fails
+    vector<uint32_t> threshold;     // keep the slot when (uint32_t)draw < threshold
+    double total = 0;               // weight mass after card removal
+
+    bool build(const vector<float>& weights, uint64_t dead) {
+        combo.clear();
+        vector<double> w;
+        total = 0;
+        for(int h=0;h<NUM_COMBOS;++h) {
+            if(weights[h] <= 0 || (comboMask(h) & dead)) continue;
+            combo.push_back((uint16_t)h);
+            w.push_back(weights[h]);
+            total += weights[h];
+        }
+        int n = (int)combo.size();
+        alias.assign(n, 0);
+        threshold.assign(n, 0);
+        if(!n) return false;
+        vector<double> scaled(n);
+        vector<int> small, large;
+        for(int i=0;i<n;++i) {
+            scaled[i] = w[i] * n / total;
+            (scaled[i] < 1.0 ? small : large).push_back(i);
+        }
+        while(!small.empty() && !large.empty()) {
+            int s = small.back(), l = large.back();
+            small.pop_back();
+            threshold[s] = (uint32_t)min(4294967295.0, scaled[s] * 4294967296.0);
+            alias[s] = (uint16_t)l;
+            scaled[l] -= 1.0 - scaled[s];
+            if(scaled[l] < 1.0) { large.pop_back(); small.push_back(l); }
+        }
+        for(int i : large) { threshold[i] = 0xFFFFFFFFu; alias[i] = (uint16_t)i; }
+        for(int i : small) { threshold[i] = 0xFFFFFFFFu; alias[i] = (uint16_t)i; }   // rounding leftovers
+        return true;
+    }
+
+    int sample(uint64_t draw) const {
+        uint32_t slot = (uint32_t)(((draw >> 32) * combo.size()) >> 32);
+        return combo[(uint32_t)draw < threshold[slot] ? slot : alias[slot]];
+    }
+};
+
+struct RangeSampler {
+    vector<AliasTable> tables;
+    vector<int> order;              // players, fewest combos first
+    long long rejections = 0;       // deals thrown away for a shared card
+
+    // False if some range has no combo left after removing the dead cards,
+    // or if no deal without shared cards turned up in many tries.
+    bool build(const vector<vector<float>>& ranges, uint64_t dead) {
+        tables.assign(ranges.size(), AliasTable());
+        order.clear();
+        for(size_t p=0;p<ranges.size();++p) {
+            if(!tables[p].build(ranges[p], dead)) return false;
+            order.push_back((int)p);
+        }
+        sort(order.begin(), order.end(), [&](int a, int b){ return tables[a].combo.size() < tables[b].combo.size(); });
+        HandRng g(0x5EED, 0);
+        int combos[16];
+        for(int t=0;t<100000;++t)
+            if(tryDeal(g, combos, dead)) { rejections = 0; return true; }
+        return false;
+    }
+
+    // One draw for every player; false (used unchanged) on a shared card.
+    template<class Rng>
+    bool tryDeal(Rng& g, int* combos, uint64_t& used) {
+        uint64_t taken = used;
+        for(int p : order) {
+            int h = tables[p].sample(g());
+            if(comboMask(h) & taken) { ++rejections; return false; }
+            combos[p] = h;
+            taken |= comboMask(h);
+        }
+        used = taken;
+        return true;
+    }
+
+    // One combo per player without shared cards; used gets their cards.
+    template<class Rng>
+    void sample(Rng& g, int* combos, uint64_t& used) {
+        while(!tryDeal(g, combos, used)) {}
+    }
+};
+
+// Deck holding only the cards not in dead (bit cardIndex).
+void deckRemoveDead(Deck& deck, uint64_t dead) {
+    deck.reset();
+    deck.cards.erase(remove_if(deck.cards.begin(), deck.cards.end(),
+                               [&](int c){ return (dead >> cardIndex(c)) & 1; }), deck.cards.end());
+}
+
+// A random card of the deck that is not in used; marks it used. The deck
+// itself is not changed, so one live deck serves every trial.
+template<class Rng>
+int deckDrawExcept(const Deck& deck, uint64_t& used, Rng& g) {
+    for(;;) {
+        int c = deck.cards[(uint32_t)(((g() >> 32) * deck.cards.size()) >> 32)];
+        uint64_t bit = 1ULL << cardIndex(c);
+        if(!(used & bit)) { used |= bit; return c; }
+    }
+}
+
+struct EquityEstimate {
+    vector<double> equity;          // pot share per player
+    vector<double> stdError;        // standard error of each equity; infinite below two batches
+    long long trials = 0;
+};
+
+// Variance reduction options for McEquityEngine::run. Work is done in
+// batches of units (one hole-card deal and runout each):
+//   MC_STRATIFY   the draws of a batch are Latin-hypercube stratified:
+//                 each player's first alias draw sweeps the range and,
+//                 over the live cards ordered by rank then suit, each
+//                 board draw sweeps every rank/suit band once
+//   MC_ANTITHETIC each deal also plays the runout dealt from reflected
+//                 indices, pairing high boards with low ones and
+//                 swapping suits, and scores the mean of the two
+//   MC_QUASI      hole and board draws follow a Kronecker (R_d)
+//                 sequence with a fresh random shift per batch
+// Batch means are independent under every option, so the standard
+// error comes from their spread, each weighted by its number of units.
+enum McFlag { MC_STRATIFY = 1, MC_ANTITHETIC = 2, MC_QUASI = 4 };
+
+struct McOptions {
+    int flags = 0;
+    double targetError = 0;         // stop once every standard error is below this; 0 runs maxTrials
+    long long maxTrials = 1000000;  // units of work, not evaluations
+    int batch = 256;                // units per batch; the error needs several batches
+};
+
+// Shared setup for equity runs: the known board, the live deck and the
+// range samplers. Trials are accumulated into per-player sums of the pot
+// share and of its square, from which the estimate and its error follow.
+struct McEquityEngine {
+    const FastEvaluator* eval;
+    const NoFlush7Table* noFlush;
+    vector<int> board;
+    uint64_t dead = 0;
+    Deck live;
+    RangeSampler sampler;
+    int numPlayers = 0;
+    vector<int> liveByRank;         // live cards by rank then suit, for index draws
+    double alpha[21];               // R_d sequence steps, one per dimension
+    long long evaluations = 0;      // 7-card evaluations done by run()
+
+    bool setup(const vector<vector<float>>& ranges, const vector<int>& knownBoard,
+               const FastEvaluator& e, const NoFlush7Table& nf) {
+        eval = &e;
+        noFlush = &nf;
+        board = knownBoard;
+        numPlayers = (int)ranges.size();
+        dead = 0;
+        for(int c : board) dead |= 1ULL << cardIndex(c);
+        deckRemoveDead(live, dead);
+        liveByRank.assign(live.cards.begin(), live.cards.end());
+        sort(liveByRank.begin(), liveByRank.end(), [](int a, int b) {
+            int ia = cardIndex(a), ib = cardIndex(b);
+            return ia % 13 * 4 + ia / 13 < ib % 13 * 4 + ib / 13;
+        });
+        // Generalised golden ratio: the root of x^(d+1) = x + 1.
+        int dims = numPlayers + 5 - (int)board.size();
+        double phi = 2.0;
+        for(int i=0;i<40;++i) phi = pow(1.0 + phi, 1.0 / (dims + 1));
+        for(int d=0;d<dims;++d) alpha[d] = fmod(pow(1.0 / phi, d + 1), 1.0);
+        evaluations = 0;
+        return sampler.build(ranges, dead);
+    }
+
+    // One trial from given hole combos and a full board: pot shares into share[].
+    void showdown(const int* combos, const int* fullBoard, double* share) const {
+        int cards[7], idx[16], best = INT_MAX, winners = 0;
+        for(int i=0;i<5;++i) cards[i+2] = fullBoard[i];
+        for(int p=0;p<numPlayers;++p) {
+            cards[0] = COMBOS.encoded[COMBOS.cards[combos[p]][0]];
+            cards[1] = COMBOS.encoded[COMBOS.cards[combos[p]][1]];
+            idx[p] = noFlush->eval7(cards, *eval);
+            if(idx[p] < best) { best = idx[p]; winners = 1; }
+            else if(idx[p] == best) ++winners;
+        }
+        for(int p=0;p<numPlayers;++p) share[p] = (idx[p] == best ? 1.0 / winners : 0.0);
+    }
+
+    // Plain Monte Carlo: n independent trials added to sum / sumSq.
+    template<class Rng>
+    void runPlain(long long n, Rng& g, double* sum, double* sumSq) {
+        int combos[16], full[5];
+        double share[16];
+        for(long long t=0;t<n;++t) {
+            uint64_t used = dead;
+            sampler.sample(g, combos, used);
+            for(int i=0;i<5;++i) full[i] = (i < (int)board.size() ? board[i] : deckDrawExcept(live, used, g));
+            showdown(combos, full, share);
+            for(int p=0;p<numPlayers;++p) { sum[p] += share[p]; sumSq[p] += share[p] * share[p]; }
+        }
+    }
+
+    // Replays preset 64-bit draws, then continues with the generator.
+    struct PresetRng {
+        const uint64_t* draws;
+        int n, i;
+        HandRng& g;
+        uint64_t operator()() { return i < n ? draws[i++] : g(); }
+    };
+
+    // Deal the missing board cards by index from the live cards in avail
+    // (m of them) using the uniforms u, reflected for the antithetic
+    // partner, and score the showdown into share[].
+    void runout(const int* combos, const int* availIn, int m, const double* u, bool reflect, double* share) {
+        int avail[52], full[5];
+        memcpy(avail, availIn, m * sizeof(int));
+        int nb = (int)board.size();
+        for(int i=0;i<nb;++i) full[i] = board[i];
+        for(int i=nb;i<5;++i) {
+            int idx = min(m - 1, (int)(u[i - nb] * m));
+            if(reflect) idx = m - 1 - idx;
+            full[i] = avail[idx];
+            memmove(avail + idx, avail + idx + 1, (m - idx - 1) * sizeof(int));
+            --m;
+        }
+        showdown(combos, full, share);
+        evaluations += numPlayers;
+    }
+
+    // One unit: pot shares into share[]. u holds one uniform per player
+    // (its first hole draw, unless plain random) and one per board draw.
+    void runUnit(int flags, const double* u, HandRng& g, double* share) {
+        int combos[16], avail[52], m = 0;
+        uint64_t used = dead;
+        if(flags & (MC_QUASI | MC_STRATIFY)) {
+            uint64_t draws[16];
+            for(int p=0;p<numPlayers;++p) draws[p] = (uint64_t)(u[p] * 18446744073709551616.0);
+            PresetRng pr{draws, numPlayers, 0, g};
+            sampler.sample(pr, combos, used);
+        } else {
+            sampler.sample(g, combos, used);
+        }
+        for(int c : liveByRank) if(!((used >> cardIndex(c)) & 1)) avail[m++] = c;
+        runout(combos, avail, m, u + numPlayers, false, share);
+        if(flags & MC_ANTITHETIC) {
+            double partner[16];
+            runout(combos, avail, m, u + numPlayers, true, partner);
+            for(int p=0;p<numPlayers;++p) share[p] = 0.5 * (share[p] + partner[p]);
+        }
+    }
+
+    // Mean pot shares of one batch of n units into mean[].
+    void runBatch(int flags, int n, HandRng& g, double* mean) {
+        int dims = numPlayers + 5 - (int)board.size();
+        vector<double> u((size_t)n * dims), sq(numPlayers);
+        double shift[21];
+        for(int d=0;d<dims;++d) shift[d] = (g() >> 11) * 0x1p-53;
+        for(int i=0;i<n;++i)
+            for(int d=0;d<dims;++d) {
+                double x = shift[d] + (double)i * alpha[d];
+                u[(size_t)i * dims + d] = (flags & MC_QUASI) ? x - floor(x) : (g() >> 11) * 0x1p-53;
+            }
+        if(flags & MC_STRATIFY) {
+            vector<int> perm(n);
+            for(int d=0;d<dims;++d) {
+                iota(perm.begin(), perm.end(), 0);
+                for(int i=n-1;i>0;--i) swap(perm[i], perm[g.below(i + 1)]);
+                for(int i=0;i<n;++i) u[(size_t)i * dims + d] = (perm[i] + (g() >> 11) * 0x1p-53) / n;
+            }
+        }
+        for(int p=0;p<numPlayers;++p) mean[p] = 0;
+        if(flags == 0) {
+            evaluations += (long long)n * numPlayers;
+            runPlain(n, g, mean, sq.data());
+        } else {
+            double share[16];
+            for(int i=0;i<n;++i) {
+                runUnit(flags, &u[(size_t)i * dims], g, share);
+                for(int p=0;p<numPlayers;++p) mean[p] += share[p];
+            }
+        }
+        for(int p=0;p<numPlayers;++p) mean[p] /= n;
+    }
+
+    // Batches until maxTrials units or, after at least 16 batches, every
+    // player's standard error is at most targetError.
+    EquityEstimate run(const McOptions& opt, HandRng& g) {
+        vector<double> sum(numPlayers, 0.0), sumSq(numPlayers, 0.0), mean(numPlayers);
+        long long units = 0, batches = 0;
+        EquityEstimate est;
+        while(units < opt.maxTrials) {
+            int n = (int)min((long long)opt.batch, opt.maxTrials - units);
+            runBatch(opt.flags, n, g, mean.data());
+            for(int p=0;p<numPlayers;++p) { sum[p] += n * mean[p]; sumSq[p] += n * mean[p] * mean[p]; }
+            units += n;
+            ++batches;
+            if(opt.targetError > 0 && batches >= 16) {
+                est = estimate(sum.data(), sumSq.data(), numPlayers, units, batches);
+                if(*max_element(est.stdError.begin(), est.stdError.end()) <= opt.targetError) break;
+            }
+        }
+        return estimate(sum.data(), sumSq.data(), numPlayers, units, batches);
+    }
+
+    // sum and sumSq hold n * mean and n * mean^2 of each batch of n units.
+    // A batch of n units has variance sigma^2 / n, so sigma^2 is estimated by
+    // sum n (mean_b - mean)^2 / (batches - 1) and the error is sigma / sqrt(units).
+    // With fewer than two batches there is no spread to measure and the
+    // error is infinite.
+    static EquityEstimate estimate(const double* sum, const double* sumSq, int np, long long units, long long batches) {
+        EquityEstimate est;
+        est.trials = units;
+        for(int p=0;p<np;++p) {
+            double mean = units > 0 ? sum[p] / units : 0;
+            est.equity.push_back(mean);
+            if(batches < 2) { est.stdError.push_back(numeric_limits<double>::infinity()); continue; }
+            double var = max(0.0, sumSq[p] - units * mean * mean) / (batches - 1);
+            est.stdError.push_back(sqrt(var / units));
+        }
+        return est;
+    }
+};
+
+// Why an anytime run returned.
+enum McStop { MC_STOP_TRIALS, MC_STOP_ERROR, MC_STOP_DEADLINE, MC_STOP_CANCELLED };
+
+// Budgets for anytimeEquity. Whichever of options.maxTrials, options.
+// targetError, the time budget or the cancel flag comes first ends the
+// run; the estimate so far is returned with its error bars. The deadline
+// waits for a second merged batch so that the error can be measured; a
+// run cancelled before that reports an infinite error.
+struct AnytimeRequest {
+    McOptions options;
+    chrono::microseconds budget{0};             // 0: no time limit
+    int threads = 1;
+    const atomic<bool>* cancel = nullptr;       // set from any thread to stop early
+    function<void(const EquityEstimate&)> progress;  // refined estimates, called under a lock
+    chrono::microseconds progressEvery{100000};
+};
+
+struct AnytimeResult {
+    EquityEstimate estimate;
+    long long evaluations = 0;
+    double seconds = 0;
+    McStop stoppedBy = MC_STOP_TRIALS;
+};
+
+// Batches run on every thread, each with its own copy of the engine and
+// its own HandRng stream, and are merged as they finish. The thread that
+// merges a batch checks the budgets, so the overshoot is at most one
+// batch per thread; keep options.batch small for millisecond deadlines.
+AnytimeResult anytimeEquity(const McEquityEngine& engine, const AnytimeRequest& req, uint64_t seed) {
+    typedef chrono::steady_clock Clock;
+    const int np = engine.numPlayers;
+    const Clock::time_point start = Clock::now();
+    const Clock::time_point deadline = start + req.budget;
+    vector<double> sum(np, 0.0), sumSq(np, 0.0);
+    long long units = 0, batches = 0, evaluations = 0;
+    Clock::time_point lastProgress = start;
+    AnytimeResult result;
+    atomic<bool> stop(false);
+    mutex lock;
+
+    auto worker = [&](int t) {
+        McEquityEngine local = engine;
+        HandRng g(seed, (uint64_t)t);
+        vector<double> mean(np);
+        while(!stop.load(memory_order_relaxed)) {
+            local.evaluations = 0;
+            local.runBatch(req.options.flags, req.options.batch, g, mean.data());
+            Clock::time_point now = Clock::now();
+            lock_guard<mutex> guard(lock);
+            if(stop.load(memory_order_relaxed)) break;
+            int n = req.options.batch;
+            for(int p=0;p<np;++p) { sum[p] += n * mean[p]; sumSq[p] += n * mean[p] * mean[p]; }
+            units += n;
+            evaluations += local.evaluations;
+            ++batches;
+            bool timeUp = req.budget.count() > 0 && now >= deadline && batches >= 2;
+            bool cancelled = req.cancel && req.cancel->load(memory_order_relaxed);
+            bool report = req.progress && now - lastProgress >= req.progressEvery;
+            if(!timeUp && !cancelled && !report && units < req.options.maxTrials &&
+               !(req.options.targetError > 0 && batches >= 16)) continue;
+            EquityEstimate est = McEquityEngine::estimate(sum.data(), sumSq.data(), np, units, batches);
+            if(report) { req.progress(est); lastProgress = now; }
+            McStop why = MC_STOP_TRIALS;
+            if(cancelled) why = MC_STOP_CANCELLED;
+            else if(timeUp) why = MC_STOP_DEADLINE;
+            else if(units >= req.options.maxTrials) why = MC_STOP_TRIALS;
+            else if(req.options.targetError > 0 && batches >= 16 &&
+                    *max_element(est.stdError.begin(), est.stdError.end()) <= req.options.targetError)
+                why = MC_STOP_ERROR;
+            else continue;
+            result.stoppedBy = why;
+            stop = true;
+        }
+    };
+    parallelFor(max(1, req.threads), max(1, req.threads), worker);
+
+    result.estimate = McEquityEngine::estimate(sum.data(), sumSq.data(), np, units, batches);
+    result.evaluations = evaluations;
+    result.seconds = chrono::duration<double>(Clock::now() - start).count();
+    return result;
+}
+
+// Exact equity of weighted ranges: every deal of one combo per player
+// without shared cards, weighted by the product of the combo weights,
+// each completed exactly over the board. Meant for checks on narrow
+// ranges; the cost is the number of deals times exactEquity.
+vector<double> exactRangeEquity(const vector<vector<float>>& ranges, const vector<int>& board,
+                                const FastEvaluator& eval, const NoFlush7Table& noFlush, long long& deals) {
+    int np = (int)ranges.size();
+    uint64_t dead = 0;
+    for(int c : board) dead |= 1ULL << cardIndex(c);
+    vector<double> total(np, 0.0), share(np);
+    double weightSum = 0;
+    int hole[16][2];
+    deals = 0;
+    function<void(int, uint64_t, double)> deal = [&](int p, uint64_t used, double w) {
+        if(p == np) {
+            exactEquity(hole, np, board.data(), (int)board.size(), eval, noFlush, share.data());
+            for(int i=0;i<np;++i) total[i] += w * share[i];
+            weightSum += w;
+            ++deals;
+            return;
+        }
+        for(int h=0;h<NUM_COMBOS;++h) {
+            if(ranges[p][h] <= 0 || (comboMask(h) & used)) continue;
+            hole[p][0] = COMBOS.encoded[COMBOS.cards[h][0]];
+            hole[p][1] = COMBOS.encoded[COMBOS.cards[h][1]];
+            deal(p + 1, used | comboMask(h), w * ranges[p][h]);
+        }
+    };
+    deal(0, dead, 1.0);
+    for(double& t : total) t = weightSum > 0 ? t / weightSum : 0;
+    return total;
+}
+
+// Split args into ranges and an optional board (a token of 3..5 cards).
+bool parseEquityArgs(const vector<string>& args, vector<vector<float>>& ranges, vector<int>& board,
+                     vector<string>& names) {
+    bool haveBoard = false;
+    for(const string& a : args) {
+        if(a.compare(0, 6, "board=") == 0) {
+            string text = a.substr(6);
+            vector<int> cards;
+            uint64_t used = 0;
+            for(size_t i=0;i+1<text.size();i+=2) cards.push_back(parseCard(text[i], text[i+1]));
+            bool ok = !haveBoard && text.size() % 2 == 0 && find(cards.begin(), cards.end(), -1) == cards.end() &&
+                      (cards.empty() || (cards.size() >= 3 && cards.size() <= 5));
+            for(size_t i=0;ok && i<cards.size();++i) {
+                uint64_t bit = 1ULL << cardIndex(cards[i]);
+                ok = !(used & bit);
+                used |= bit;
+            }
+            if(!ok) { cerr << "Board must be given once, with 0, 3, 4 or 5 distinct cards: " << a << "\n"; return false; }
+            board = cards;
+            haveBoard = true;
+            continue;
+        }
+        vector<float> w;
+        if(!parseRange(a, w)) { cerr << "Bad range: " << a << "\n"; return false; }
+        ranges.push_back(w);
+        names.push_back(a);
+    }
+    if(ranges.size() < 2 || ranges.size() > 16) { cerr << "Need 2..16 ranges\n"; return false; }
+    return true;
+}
+
+// Mode "mcequity <range> <range>... [board=<cards>] [trials] [options]": Monte
+// Carlo equity of weighted ranges. Options: stratify, antithetic, quasi,
+// se=<target standard error>, compare (evaluations each variance
+// reduction needs to reach the target error, against plain sampling),
+// for the anytime API ms=<time budget>, threads=<n> and progress, and
+// exact (also enumerate the weighted exact equity and fail when the
+// estimate is more than 4 standard errors away).
+int runMonteCarloEquity(vector<string> args, const CanonTable& table) {
+    McOptions opt;
+    bool compare = false, anytime = false, progress = false, exact = false;
+    double budgetMs = 0;
+    int threads = 1;
+    vector<string> rest;
+    for(const string& a : args) {
+        if(a == "stratify") opt.flags |= MC_STRATIFY;
+        else if(a == "antithetic") opt.flags |= MC_ANTITHETIC;
+        else if(a == "quasi") opt.flags |= MC_QUASI;
+        else if(a == "compare") compare = true;
+        else if(a == "exact") exact = true;
+        else if(a == "progress") anytime = progress = true;
+        else if(a.compare(0, 3, "ms=") == 0) { anytime = true; budgetMs = atof(a.c_str() + 3); }
+        else if(a.compare(0, 8, "threads=") == 0) { anytime = true; threads = max(1, atoi(a.c_str() + 8)); }
+        else if(a.compare(0, 3, "se=") == 0) opt.targetError = atof(a.c_str() + 3);
+        else if(!a.empty() && all_of(a.begin(), a.end(), ::isdigit)) opt.maxTrials = atoll(a.c_str());
+        else rest.push_back(a);
+    }
+    vector<vector<float>> ranges;
+    vector<int> board;
+    vector<string> names;
+    if(!parseEquityArgs(rest, ranges, board, names)) return 1;
+    FastEvaluator eval;
+    eval.build(table);
+    NoFlush7Table noFlush;
+    noFlush.build(eval);
+    McEquityEngine engine;
+    if(!engine.setup(ranges, board, eval, noFlush)) {
+        cerr << "A range is empty after card removal, or the ranges cannot be dealt together\n";
+        return 1;
+    }
+    HandRng g(((uint64_t)rd() << 32) ^ rd(), 0);
+
+    if(compare) {
+        if(opt.targetError <= 0) opt.targetError = 0.001;
+        static const char* labels[] = {"plain", "stratify", "antithetic", "stratify+antithetic",
+                                       "quasi", "stratify+quasi", "antithetic+quasi", "all"};
+        double plainCost = 0;
+        cout << "Units per option: " << opt.maxTrials << "; evaluations to reach "
+             << opt.targetError * 100 << "% error extrapolated from the measured error\n";
+        for(int flags=0; flags<8; ++flags) {
+            McOptions run = opt;
+            run.flags = flags;
+            run.targetError = 0;
+            engine.evaluations = 0;
+            auto t0 = chrono::steady_clock::now();
+            EquityEstimate est = engine.run(run, g);
+            double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+            double se = *max_element(est.stdError.begin(), est.stdError.end());
+            double cost = engine.evaluations * (se / opt.targetError) * (se / opt.targetError);
+            if(flags == 0) plainCost = cost;
+            cout << "  " << left << setw(20) << labels[flags] << right << fixed << setprecision(3)
+                 << est.equity[0] * 100 << "% +- " << se * 100 << "  evals " << setw(10) << (long long)cost
+                 << "  " << setprecision(2) << plainCost / cost << "x fewer  "
+                 << setprecision(3) << secs << " s\n" << defaultfloat;
+        }
+        return 0;
+    }
+
+    if(anytime) {
+        AnytimeRequest req;
+        req.options = opt;
+        req.options.batch = 64;
+        req.budget = chrono::microseconds((long long)(budgetMs * 1000));
+        req.threads = threads;
+        if(progress) {
+            req.progressEvery = chrono::microseconds(max(1LL, (long long)(budgetMs * 100)));
+            req.progress = [](const EquityEstimate& e) {
+                cout << "  ... " << setw(9) << e.trials << " units  " << fixed << setprecision(3)
+                     << e.equity[0] * 100 << "% +- " << e.stdError[0] * 100 << "\n" << defaultfloat;
+            };
+        }
+        AnytimeResult res = anytimeEquity(engine, req, ((uint64_t)rd() << 32) ^ rd());
+        static const char* why[] = {"trial limit", "target error", "deadline", "cancelled"};
+        for(size_t p=0;p<ranges.size();++p)
+            cout << "  " << left << setw(24) << names[p] << right << fixed << setprecision(3)
+                 << res.estimate.equity[p] * 100 << "% +- " << res.estimate.stdError[p] * 100 << "\n";
+        cout << defaultfloat << "Units: " << res.estimate.trials << "  Evaluations: " << res.evaluations
+             << " in " << res.seconds * 1000 << " ms on " << threads << " thread(s), stopped by "
+             << why[res.stoppedBy] << "\n";
+        return 0;
+    }
+
+    if(opt.flags == 0 && opt.targetError == 0) {
+        int combos[16];
+        long long checksum = 0;
+        const int samples = 20000000;
+        auto t0 = chrono::steady_clock::now();
+        for(int i=0;i<samples;++i) {
+            uint64_t used = engine.dead;
+            engine.sampler.sample(g, combos, used);
+            checksum += combos[0];
+        }
+        double sampleSecs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        cout << "Sampler: " << samples / sampleSecs / 1e6 << " M deals/s (" << ranges.size() << " ranges, "
+             << engine.sampler.rejections << " rejected deals; checksum "
+             << checksum % 1000 << ")\n";
+    }
+
+    auto t0 = chrono::steady_clock::now();
+    EquityEstimate est = engine.run(opt, g);
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    for(size_t p=0;p<ranges.size();++p)
+        cout << "  " << left << setw(24) << names[p] << right << fixed << setprecision(3)
+             << est.equity[p] * 100 << "% +- " << est.stdError[p] * 100 << "\n";
+    cout << defaultfloat << "Units: " << est.trials << "  Evaluations: " << engine.evaluations
+         << " in " << secs << " s\n";
+    if(!exact) return 0;
+
+    long long deals = 0;
+    vector<double> want = exactRangeEquity(ranges, board, eval, noFlush, deals);
+    double worst = 0;
+    cout << "Exact over " << deals << " deals:\n";
+    for(size_t p=0;p<ranges.size();++p) {
+        double z = (est.equity[p] - want[p]) / max(1e-12, est.stdError[p]);
+        worst = max(worst, fabs(z));
+        cout << "  " << left << setw(24) << names[p] << right << fixed << setprecision(3)
+             << want[p] * 100 << "%  (estimate off by " << setprecision(2) << z << " SE)\n" << defaultfloat;
+    }
+    return worst > 4 ? 1 : 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION T — Vectorized environment for reinforcement learning
+   VecEnv steps N independent heads-up limit tables in one call, Gym
+   style: reset() deals every table, step() takes one action per table
+   and fills the reward/done/legal-mask/to-act arrays. State is kept as
+   structure-of-arrays: the whole betting state of a table is its
+   HistoryKey (Section F), so stepping is a few table lookups and chips
+   are read back from the automaton. A hand that ends is settled and
+   replaced at once (auto-reset); the reward of the finished hand is
+   reported on that step together with done = 1, while legal/toAct
+   already describe the new hand. Nothing is allocated after
+   construction.
+   ------------------------------------------------------------------ */
+
+const int ENV_CARDS = 9;            // hole cards of player 1, of player 2, then the board
+
+struct VecEnv {
+    int numTables;
+    uint64_t runSeed;               // hand n is dealt from HandRng(runSeed, n)
+    uint64_t nextHand = 1;
+    const FastEvaluator& eval;
+    const NoFlush7Table& noFlush;
+
+    // per-table state
+    vector<uint8_t> cards;          // numTables x ENV_CARDS, cardIndex
+    vector<HistoryKey> history;
+    vector<uint8_t> firstToAct;     // 1 or 2, opens preflop
+    vector<uint64_t> handNumber;
+
+    // outputs of reset/step
+    vector<uint8_t> legal;          // legalMask of the player to act
+    vector<uint8_t> toAct;          // 1 or 2
+    vector<float> reward;           // chips won by player 1 in the hand that ended, else 0
+    vector<uint8_t> done;
+    long long handsPlayed = 0;
+
+    VecEnv(int n, const FastEvaluator& e, const NoFlush7Table& nf, uint64_t seed = random_device{}())
+        : numTables(n), runSeed(seed), eval(e), noFlush(nf), cards((size_t)n * ENV_CARDS),
+          history(n), firstToAct(n), handNumber(n), legal(n), toAct(n), reward(n), done(n) {}
+
+    // Odd hand numbers let player 1 open preflop, as in main.
+    void deal(int t) {
+        uint64_t hand = nextHand++;
+        HandRng g(runSeed, hand);
+        uint8_t deck[52];
+        for(int i=0;i<52;++i) deck[i] = (uint8_t)i;
+        uint8_t* out = &cards[(size_t)t * ENV_CARDS];
+        for(int i=0;i<ENV_CARDS;++i) {
+            int j = i + (int)g.below(52 - i);
+            swap(deck[i], deck[j]);
+            out[i] = deck[i];
+        }
+        handNumber[t] = hand;
+        firstToAct[t] = (uint8_t)(hand % 2 != 0 ? 1 : 2);
+        history[t] = HISTORY_ROOT;
+        legal[t] = (uint8_t)historyLegalMask(HISTORY_ROOT);
+        toAct[t] = firstToAct[t];
+    }
+
+    void reset(uint64_t seed) {
+        runSeed = seed;
+        nextHand = 1;
+        handsPlayed = 0;
+        for(int t=0;t<numTables;++t) { deal(t); reward[t] = 0; done[t] = 0; }
+    }
+
+    // Chips won by player 1 in a finished hand; folder is the player who
+    // folded, 0 for a showdown.
+    int settle(int t, HistoryKey h, int folder) const {
+        int chips[2];
+        historyChips(h, firstToAct[t], chips);
+        if(folder) return folder == 1 ? -chips[0] : chips[1];
+        const uint8_t* c = &cards[(size_t)t * ENV_CARDS];
+        int c1[7], c2[7];
+        for(int i=0;i<5;++i) c1[i+2] = c2[i+2] = COMBOS.encoded[c[4+i]];
+        c1[0] = COMBOS.encoded[c[0]]; c1[1] = COMBOS.encoded[c[1]];
+        c2[0] = COMBOS.encoded[c[2]]; c2[1] = COMBOS.encoded[c[3]];
+        int idx1 = noFlush.eval7(c1, eval), idx2 = noFlush.eval7(c2, eval);
+        return idx1 < idx2 ? chips[1] : idx2 < idx1 ? -chips[0] : 0;
+    }
+
+    // One action per table (Action values); an illegal action is replaced
+    // by the first legal one, as in LockstepRunner.
+    void step(const uint8_t* actions) {
+        for(int t=0;t<numTables;++t) {
+            int a = actions[t];
+            if(a >= NUM_ACTIONS || !((legal[t] >> a) & 1)) a = __builtin_ctz(legal[t]);
+            HistoryKey h = historyAppend(history[t], (Action)a);
+            if(!historyTerminal(h)) {
+                history[t] = h;
+                legal[t] = (uint8_t)historyLegalMask(h);
+                toAct[t] = (uint8_t)historyToAct(h, firstToAct[t]);
+                reward[t] = 0;
+                done[t] = 0;
+                continue;
+            }
+            reward[t] = (float)settle(t, h, a == A_FOLD ? toAct[t] : 0);
+            done[t] = 1;
+            ++handsPlayed;
+            deal(t);
+        }
+    }
+
+    // Observations of the players to act, Section G layout (numTables x OBS_WIDTH).
+    void observe(int32_t* obs) const {
+        for(int t=0;t<numTables;++t) {
+            int32_t* row = obs + (size_t)t * OBS_WIDTH;
+            const uint8_t* c = &cards[(size_t)t * ENV_CARDS];
+            HistoryKey h = history[t];
+            int street = historyStreet(h), me = toAct[t] - 1, chips[2];
+            historyChips(h, firstToAct[t], chips);
+            row[OBS_PLAYER] = toAct[t];
+            row[OBS_STREET] = street;
+            row[OBS_HOLE] = c[2*me];
+            row[OBS_HOLE + 1] = c[2*me + 1];
+            for(int i=0;i<5;++i) row[OBS_BOARD + i] = (i < BOARD_VISIBLE[street] ? c[4+i] : -1);
+            row[OBS_POT] = chips[0] + chips[1];
+            row[OBS_MY_CHIPS] = chips[me];
+            row[OBS_OPP_CHIPS] = chips[1-me];
+            int n = 0;
+            for(int s=0;s<=street;++s) {
+                Action acts[MAX_HAND_ACTIONS];
+                int k = historyStreetActions(h, s, acts);
+                for(int i=0;i<k && n<MAX_HAND_ACTIONS;++i) row[OBS_HISTORY + n++] = 1 + s*NUM_ACTIONS + acts[i];
+            }
+            row[OBS_NUM_ACTIONS] = n;
+            for(int i=n;i<MAX_HAND_ACTIONS;++i) row[OBS_HISTORY + i] = 0;
+        }
+    }
+};
+
+// Mode "vecenv <tables> <steps>": random legal actions on every table,
+// reporting env steps per second. Table 0 is mirrored through the
+// Section G LockstepHand rules, and every settled result must agree.
+int runVecEnv(int tables, long long steps, const CanonTable& table) {
+    FastEvaluator eval;
+    eval.build(table);
+    NoFlush7Table noFlush;
+    noFlush.build(eval);
+    VecEnv env(tables, eval, noFlush);
+    env.reset(((uint64_t)rd() << 32) ^ rd());
+    vector<uint8_t> actions(tables);
+    HandRng g(env.runSeed, ~0ULL);
+
+    // legal actions of each mask, to pick uniformly without branching on bits
+    uint8_t choices[32][3], numChoices[32];
+    for(int m=0;m<32;++m) {
+        numChoices[m] = 0;
+        for(int a=0;a<NUM_ACTIONS;++a) if((m >> a) & 1 && numChoices[m] < 3) choices[m][numChoices[m]++] = (uint8_t)a;
+    }
+    auto pick = [&]() {
+        for(int t=0;t<tables;++t) {
+            int m = env.legal[t];
+            actions[t] = choices[m][g.below(numChoices[m])];
+        }
+    };
+
+    // check against LockstepHand for a while on table 0
+    LockstepHand mirror;
+    auto loadMirror = [&]() {
+        const uint8_t* c = &env.cards[0];
+        HandRng unused(0, 0);
+        lockstepDeal(mirror, (int)env.handNumber[0], unused);
+        for(int i=0;i<2;++i) { mirror.hole[0][i] = COMBOS.encoded[c[i]]; mirror.hole[1][i] = COMBOS.encoded[c[2+i]]; }
+        for(int i=0;i<5;++i) mirror.board[i] = COMBOS.encoded[c[4+i]];
+    };
+    loadMirror();
+    long long checked = 0, mismatches = 0, net = 0;
+    for(int i=0;i<200000 / max(1, tables) + 1000;++i) {
+        pick();
+        if(env.legal[0] != legalMask(mirror.st) || env.toAct[0] != mirror.st.current) ++mismatches;
+        lockstepApply(mirror, (Action)actions[0], table);
+        env.step(actions.data());
+        if(env.done[0] != (mirror.done ? 1 : 0) || (mirror.done && env.reward[0] != mirror.result)) ++mismatches;
+        if(mirror.done) { ++checked; loadMirror(); }
+    }
+    cout << "Checked " << checked << " hands against LockstepHand: " << mismatches << " mismatches\n";
+
+    env.reset(env.runSeed + 1);
+    auto t0 = chrono::steady_clock::now();
+    long long done = 0;
+    for(long long i=0;i<steps;++i) {
+        pick();
+        env.step(actions.data());
+        for(int t=0;t<tables;++t) { net += (long long)env.reward[t]; done += env.done[t]; }
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << "Tables: " << tables << "  Steps: " << steps << "  Env steps: " << steps * tables
+         << "  Hands: " << done << "  Player 1 net: " << net << "\n";
+    cout << "Time: " << secs << " s  (" << steps * tables / secs / 1e6 << " M env steps/s, policy included)\n";
+
+    vector<int32_t> obs((size_t)tables * OBS_WIDTH);
+    t0 = chrono::steady_clock::now();
+    long long obsSteps = max(1LL, steps / 4);
+    for(long long i=0;i<obsSteps;++i) { pick(); env.step(actions.data()); env.observe(obs.data()); }
+    secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << "With observations: " << obsSteps * tables / secs / 1e6 << " M env steps/s\n";
+    return mismatches ? 1 : 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION U — Monte Carlo tree search bot
+   Information-set MCTS over the limit betting rules of Section F, on
+   HandState apply/undo. Each iteration determinizes the hidden cards
+   (opponent hole cards and the undealt board) uniformly from the cards
+   the searching player cannot see, descends the betting tree by UCT,
+   expands one node, finishes the hand with random legal actions and
+   backs the chips up. Since legality never depends on the cards, one
+   betting tree serves every determinization.
+   Threads search one shared tree. Nodes come from a fixed pool by an
+   atomic bump index; children are published with a compare-and-swap
+   and statistics are atomic counters, so no locks are taken. A thread
+   counts its visit on the way down, which steers the others away from
+   the same line until its result is in (virtual loss).
+   ------------------------------------------------------------------ */
+
+struct MctsNode {
+    atomic<int32_t> child[NUM_ACTIONS];     // pool index, -1 until expanded
+    atomic<uint32_t> visits;
+    atomic<int64_t> payoff;                 // chips won by the player who moved into this node
+};
+
+struct MctsPool {
+    unique_ptr<MctsNode[]> nodes;
+    uint32_t capacity;
+    atomic<uint32_t> used{0};
+
+    explicit MctsPool(uint32_t cap) : nodes(new MctsNode[cap]), capacity(cap) {}
+
+    void clear() { used = 0; }
+
+    // A fresh node, or -1 when the pool is full.
+    int32_t allocate() {
+        uint32_t i = used.fetch_add(1, memory_order_relaxed);
+        if(i >= capacity) return -1;
+        MctsNode& n = nodes[i];
+        for(auto& c : n.child) c.store(-1, memory_order_relaxed);
+        n.visits.store(0, memory_order_relaxed);
+        n.payoff.store(0, memory_order_relaxed);
+        return (int32_t)i;
+    }
+};
+
+// Iteration cap used when a config sets neither a cap nor a time budget.
+const long long MCTS_DEFAULT_ITERATIONS = 100000;
+
+struct MctsConfig {
+    int threads = 1;
+    long long maxIterations = 0;            // 0: no limit (MCTS_DEFAULT_ITERATIONS if budget is 0 too)
+    chrono::microseconds budget{1000};      // 0: no time limit
+    double exploration = 1.0;               // UCT constant, on payoffs in units of payoffScale chips
+    double payoffScale = 100.0;
+};
+
+struct MctsResult {
+    Action action = A_CHECK;
+    long long iterations = 0;
+    uint32_t nodes = 0;
+    double value = 0;                       // mean chips for the searcher under the chosen action
+};
+
+struct MctsSearch {
+    MctsPool pool;
+    const FastEvaluator& eval;
+    const NoFlush7Table& noFlush;
+
+    MctsSearch(const FastEvaluator& e, const NoFlush7Table& nf, uint32_t poolNodes = 1u << 18)
+        : pool(poolNodes), eval(e), noFlush(nf) {}
+
+    // HandState::showdownWinner through the 7-card table.
+    int winner(const HandState& st) const {
+        int c1[7], c2[7];
+        for(int i=0;i<5;++i) c1[i+2] = c2[i+2] = COMBOS.encoded[st.cards[4+i]];
+        c1[0] = COMBOS.encoded[st.cards[0]]; c1[1] = COMBOS.encoded[st.cards[1]];
+        c2[0] = COMBOS.encoded[st.cards[2]]; c2[1] = COMBOS.encoded[st.cards[3]];
+        int idx1 = noFlush.eval7(c1, eval), idx2 = noFlush.eval7(c2, eval);
+        return idx1 < idx2 ? 1 : idx2 < idx1 ? 2 : 0;
+    }
+
+    // Deal every card `me` cannot see in real at random into st.cards.
+    static void determinize(const HandState& real, int me, HandState& st, HandRng& g) {
+        uint64_t known = 0;
+        int visible = BOARD_VISIBLE[real.street()];
+        known |= 1ULL << real.cards[2*(me-1)];
+        known |= 1ULL << real.cards[2*(me-1) + 1];
+        for(int i=0;i<visible;++i) known |= 1ULL << real.cards[4+i];
+        uint8_t deck[52];
+        int n = 0;
+        for(int c=0;c<52;++c) if(!((known >> c) & 1)) deck[n++] = (uint8_t)c;
+        int slots[HAND_CARDS], k = 0;
+        slots[k++] = 2*(2-me);
+        slots[k++] = 2*(2-me) + 1;
+        for(int i=visible;i<5;++i) slots[k++] = 4 + i;
+        for(int i=0;i<k;++i) {
+            int j = i + (int)g.below(n - i);
+            swap(deck[i], deck[j]);
+            st.cards[slots[i]] = deck[i];
+        }
+    }
+
+    // One iteration from the root state st (restored before returning).
+    void iterate(HandState& st, int me, const HandState& real, int32_t root, const MctsConfig& cfg, HandRng& g) {
+        determinize(real, me, st, g);
+        int result = winner(st);
+        int32_t path[MAX_HAND_ACTIONS + 1];
+        int8_t movers[MAX_HAND_ACTIONS + 1];
+        int len = 0, startDepth = st.depth;
+        path[len] = root;
+        movers[len++] = 0;
+        pool.nodes[root].visits.fetch_add(1, memory_order_relaxed);
+        int32_t node = root;
+        while(node >= 0 && !st.terminal()) {
+            MctsNode& n = pool.nodes[node];
+            int mask = st.legal(), mover = st.toAct();
+            int pick = -1;
+            for(int m = mask; m; m &= m - 1) {
+                int a = __builtin_ctz(m);
+                if(n.child[a].load(memory_order_acquire) < 0) { pick = a; break; }
+            }
+            int32_t next;
+            bool expanded = pick >= 0;
+            if(expanded) {
+                // expand: publish a new node, or adopt the one another thread just added
+                next = pool.allocate();
+                int32_t expected = -1;
+                if(next >= 0 && !n.child[pick].compare_exchange_strong(expected, next, memory_order_acq_rel))
+                    next = expected;
+            } else {
+                double logN = log((double)max(1u, n.visits.load(memory_order_relaxed)));
+                double best = -1e300;
+                for(int m = mask; m; m &= m - 1) {
+                    int a = __builtin_ctz(m);
+                    const MctsNode& c = pool.nodes[n.child[a].load(memory_order_acquire)];
+                    double v = max(1u, c.visits.load(memory_order_relaxed));
+                    double score = c.payoff.load(memory_order_relaxed) / (v * cfg.payoffScale)
+                                 + cfg.exploration * sqrt(logN / v);
+                    if(score > best) { best = score; pick = a; }
+                }
+                next = n.child[pick].load(memory_order_acquire);
+            }
+            st.apply((Action)pick);
+            if(next < 0) break;                     // pool full: roll out from here
+            pool.nodes[next].visits.fetch_add(1, memory_order_relaxed);
+            path[len] = next;
+            movers[len++] = (int8_t)mover;
+            node = expanded ? -1 : next;
+        }
+        while(!st.terminal()) {
+            int mask = st.legal(), k = (int)g.below(__builtin_popcount(mask));
+            while(k--) mask &= mask - 1;
+            st.apply((Action)__builtin_ctz(mask));
+        }
+        int p1 = st.payoff(result);
+        for(int i=1;i<len;++i)
+            pool.nodes[path[i]].payoff.fetch_add(movers[i] == 1 ? p1 : -p1, memory_order_relaxed);
+        while(st.depth > startDepth) st.undo();
+    }
+
+    // Best action for the player to act in real (who must not be at a terminal).
+    MctsResult search(const HandState& real, const MctsConfig& cfg, uint64_t seed) {
+        typedef chrono::steady_clock Clock;
+        pool.clear();
+        int32_t root = pool.allocate();
+        int me = real.toAct();
+        atomic<long long> iterations(0);
+        atomic<bool> stop(false);
+        Clock::time_point deadline = Clock::now() + cfg.budget;
+        long long cap = cfg.maxIterations;
+        if(!cap && cfg.budget.count() <= 0) cap = MCTS_DEFAULT_ITERATIONS;
+        int threads = max(1, cfg.threads);
+        parallelFor(threads, threads, [&](int t) {
+            HandState st = real;
+            HandRng g(seed, (uint64_t)t);
+            while(!stop.load(memory_order_relaxed)) {
+                for(int i=0;i<16;++i) iterate(st, me, real, root, cfg, g);
+                long long done = iterations.fetch_add(16, memory_order_relaxed) + 16;
+                if((cap && done >= cap) ||
+                   (cfg.budget.count() > 0 && Clock::now() >= deadline))
+                    stop = true;
+            }
+        });
+        MctsResult res;
+        res.iterations = iterations.load();
+        res.nodes = min(pool.used.load(), pool.capacity);
+        uint32_t most = 0;
+        for(int m = real.legal(); m; m &= m - 1) {
+            int a = __builtin_ctz(m);
+            int32_t c = pool.nodes[root].child[a].load();
+            if(c < 0) continue;
+            uint32_t v = pool.nodes[c].visits.load();
+            if(v > most) { most = v; res.action = (Action)a; res.value = (double)pool.nodes[c].payoff.load() / v; }
+        }
+        if(!most) res.action = (Action)__builtin_ctz(real.legal());
+        return res;
+    }
+};
+
+// Mode "mcts [hands] [threads]": the MCTS bot against a calling station
+// and against random play at a few time budgets per decision; reports
+// chips won per hand and search speed.
+int runMcts(int hands, int threads, const CanonTable& table) {
+    FastEvaluator eval;
+    eval.build(table);
+    NoFlush7Table noFlush;
+    noFlush.build(eval);
+    MctsSearch search(eval, noFlush);
+    uint64_t runSeed = ((uint64_t)rd() << 32) ^ rd();
+    const double budgetsMs[] = {0.25, 1.0, 4.0};
+    const char* opponents[] = {"calling station", "random"};
+    for(int opp=0; opp<2; ++opp)
+    for(double ms : budgetsMs) {
+        MctsConfig cfg;
+        cfg.threads = threads;
+        cfg.budget = chrono::microseconds((long long)(ms * 1000));
+        long long net = 0, netSq = 0, decisions = 0, iterations = 0;
+        double searchSecs = 0;
+        for(int h=1; h<=hands; ++h) {
+            // the same deals for every budget, the bot sitting in both seats
+            HandRng g(runSeed, (uint64_t)h);
+            int deck[52], cards[HAND_CARDS];
+            for(int i=0;i<52;++i) deck[i] = i;
+            for(int i=0;i<HAND_CARDS;++i) { swap(deck[i], deck[i + g.below(52 - i)]); cards[i] = deck[i]; }
+            int botSeat = (h % 4 < 2 ? 1 : 2);
+            HandState st;
+            st.reset(cards, h % 2 != 0 ? 1 : 2);
+            while(!st.terminal()) {
+                Action a;
+                if(st.toAct() == botSeat) {
+                    auto t0 = chrono::steady_clock::now();
+                    MctsResult r = search.search(st, cfg, g());
+                    searchSecs += chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+                    a = r.action;
+                    ++decisions;
+                    iterations += r.iterations;
+                } else if(opp == 0) {
+                    a = (st.legal() >> A_CHECK) & 1 ? A_CHECK : A_CALL;
+                } else {
+                    int mask = st.legal(), k = (int)g.below(__builtin_popcount(mask));
+                    while(k--) mask &= mask - 1;
+                    a = (Action)__builtin_ctz(mask);
+                }
+                st.apply(a);
+            }
+            int p1 = st.payoff(st.showdownWinner(eval));
+            int won = (botSeat == 1 ? p1 : -p1);
+            net += won;
+            netSq += (long long)won * won;
+        }
+        double mean = (double)net / hands;
+        double se = sqrt(max(0.0, (double)netSq / hands - mean * mean) / hands);
+        cout << "vs " << left << setw(16) << opponents[opp] << right << setw(5) << ms << " ms/decision: "
+             << fixed << setprecision(2) << setw(7) << mean << " +- " << se << " chips/hand  "
+             << setprecision(0) << (decisions ? (double)iterations / decisions : 0.0) << " iterations/decision  "
+             << setprecision(2) << iterations / max(1e-9, searchSecs) / 1e6 << " M iterations/s\n" << defaultfloat;
+    }
+    return 0;
+}
+
+/* ------------------------------------------------------------------
+   SECTION V — Heap allocation check
+   Built with -DHOLDEM_COUNT_ALLOCS, the global operator new counts
+   every heap allocation, and mode "alloccheck" plays hands after a
+   warm-up to confirm that steady-state simulation (the logged hands of
+   main and the lockstep hand loop) allocates nothing.
+   ------------------------------------------------------------------ */
+
+#ifdef HOLDEM_COUNT_ALLOCS
+static atomic<long long> heapAllocations{0};
+
+void* operator new(size_t n) {
+    heapAllocations.fetch_add(1, memory_order_relaxed);
+    if(void* p = malloc(n ? n : 1)) return p;
+    throw bad_alloc();
+}
+// GCC pairs the inlined new with these frees and warns; the pairing is ours.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+#pragma GCC diagnostic pop
+#endif
+
+// Output sink for the hand logs during the check.
+struct NullStreamBuf : streambuf {
+    int overflow(int c) override { return c; }
+    streamsize xsputn(const char*, streamsize n) override { return n; }
+};
+
+void playHandLog(int hnum, uint64_t runSeed, const CanonTable& table);    // Section W
+
+// Mode "alloccheck [hands]": heap allocations while playing hands after warm-up.
+int runAllocCheck(int hands, const CanonTable& table) {
+#ifndef HOLDEM_COUNT_ALLOCS
+    (void)hands; (void)table;
+    cerr << "Rebuild with -DHOLDEM_COUNT_ALLOCS to count heap allocations\n";
+    return 1;
+#else
+    const int WARMUP = 50;
+    uint64_t runSeed = ((uint64_t)rd() << 32) ^ rd();
+    NullStreamBuf sink;
+    streambuf* saved = cout.rdbuf(&sink);
+
+    for(int h=1; h<=WARMUP; ++h) playHandLog(h, runSeed, table);
+    long long before = heapAllocations.load();
+    auto t0 = chrono::steady_clock::now();
+    for(int h=WARMUP+1; h<=WARMUP+hands; ++h) playHandLog(h, runSeed, table);
+    double logSecs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    long long logAllocs = heapAllocations.load() - before;
+
+    LockstepHand lh;
+    auto playLockstep = [&](int h) {
+        HandRng g(runSeed, (uint64_t)h);
+        lockstepDeal(lh, h, g);
+        while(!lh.done) {
+            Action buf[3];
+            int n = legalActions(lh.st, buf);
+            lockstepApply(lh, pickRandom(buf, n, g), table);
+        }
+    };
+    for(int h=1; h<=WARMUP; ++h) playLockstep(h);
+    before = heapAllocations.load();
+    for(int h=WARMUP+1; h<=WARMUP+hands; ++h) playLockstep(h);
+    long long lockAllocs = heapAllocations.load() - before;
+
+    cout.rdbuf(saved);
+    cout << "Logged hands:   " << hands << "  heap allocations: " << logAllocs
+         << "  (" << hands / logSecs << " hands/s)\n";
+    cout << "Lockstep hands: " << hands << "  heap allocations: " << lockAllocs << "\n";
+    return (logAllocs || lockAllocs) ? 1 : 0;
+#endif
+}
+
+/* ------------------------------------------------------------------
+   SECTION W — Simulation: play n hands (we will do 3)
+   Each hand prints hole cards, each street with actions, final board,
+   and final showdown with both players' best-class index (1..7462).
+   All randomness of hand n comes from HandRng(run seed, n), so the
+   "replay" mode regenerates any hand of a run from the printed seed.
+   ------------------------------------------------------------------ */
+
+// Play hand number hnum of the run with seed runSeed and print its log.
+// Everything random in the hand comes from HandRng(runSeed, hnum).
+void playHandLog(int hnum, uint64_t runSeed, const CanonTable& table) {
+    cout << "\n==================================================\n";
+    cout << "HAND #" << hnum << "\n";
+
+    HandRng g(runSeed, (uint64_t)hnum);
+    Deck deck;
+    deck.reset();
+    deck.shuffle(g);
+    int chips1 = 10000;
+    int chips2 = 10000;
+    Action action = A_CHECK;
+    int pot = 0;
+    int firstToAct = 1;
+    int secondToAct = 2;
+    bool folded = false;
+
+    //gameState blindsState = playStreetLog("Blinds", 1);
+
+    // The hand's cards live in this thread's arena, reset for every hand.
+    HandArena& arena = HandArena::local();
+    arena.reset();
+    int* p1 = arena.alloc<int>(2);
+    int* p2 = arena.alloc<int>(2);
+    int* board = arena.alloc<int>(5);
+    for(int i=0;i<2;++i) p1[i] = deck.deal();
+    for(int i=0;i<2;++i) p2[i] = deck.deal();
+    for(int i=0;i<5;++i) board[i] = deck.deal();
+
+    cout << "Player 1: " << cardToString(p1[0]) << ", " << cardToString(p1[1]) << "\n";
+    cout << "Player 2: " << cardToString(p2[0]) << ", " << cardToString(p2[1]) << "\n";
+    
+    // Check for divisibility by 2
+    if (hnum % 2 != 0) {
+        firstToAct = 1;
+        secondToAct = 2;
+    } else {
+        firstToAct = 2;
+        secondToAct = 1;
+    }
+    
+    // Preflop (player 1 acts first)
+    gameState preflopState = playStreetLog("Preflop", firstToAct, g);
+    //action = playStreetLog("Preflop", 1);
+    action = preflopState.lastStreetAction;
+    pot = preflopState.pot;
+    int firstPlayerChips = preflopState.firstPlayerChips;
+    int secondPlayerChips = preflopState.secondPlayerChips;
+    cout << "Last preflop action: " << actionStr(action) << ", " << "Pot: " << pot << " firstPlayerChipsOnPot: " << firstPlayerChips << " secondPlayerChipsOnPot: " << secondPlayerChips << "\n";
+    //playStreetLog("Preflop", 1);
+
+    // Flop
+    if (action != A_FOLD){
+        cout << "Flop: " << cardToString(board[0]) << ", " << cardToString(board[1]) << ", " << cardToString(board[2]) << "\n";
+        //action = playStreetLog("Flop", 1);
+        gameState flopState = playStreetLog("Flop", secondToAct, g);
+        action = flopState.lastStreetAction;
+        pot = pot + flopState.pot;
+        firstPlayerChips = firstPlayerChips + flopState.firstPlayerChips;
+        secondPlayerChips = secondPlayerChips + flopState.secondPlayerChips;
+        cout << "Last flop action: " << actionStr(action) << ", " << "Pot: " << pot << " firstPlayerChipsOnPot: " << firstPlayerChips << " secondPlayerChipsOnPot: " << secondPlayerChips << "\n";
+    } else {
+        if(firstPlayerChips > secondPlayerChips){
+            cout << "secondplayer folded preflop" << " firstplayer wins: " << secondPlayerChips << "\n";
+        } else{
+            cout << "firstplayer folded preflop" << " second player wins: " << firstPlayerChips << "\n";
+        }
+        folded = true;
+    }
+
+    // Turn
+    if (action != A_FOLD){
+        cout << "Turn: " << cardToString(board[3]) << "\n";
+        //action = playStreetLog("Turn", 1);
+        gameState turnState = playStreetLog("Turn", secondToAct, g);
+        action = turnState.lastStreetAction;
+        pot = pot + turnState.pot;
+        firstPlayerChips = firstPlayerChips + turnState.firstPlayerChips;
+        secondPlayerChips = secondPlayerChips + turnState.secondPlayerChips;
+        cout << "Last turn action: " << actionStr(action) << ", " << "Pot: " << pot << " firstPlayerChipsOnPot: " << firstPlayerChips << " secondPlayerChipsOnPot: " << secondPlayerChips << "\n";
+    } else {
+        if (folded == false){
+            if(firstPlayerChips > secondPlayerChips){
+                cout << "secondplayer folded flop" << " firstplayer wins: " << secondPlayerChips << "\n";
+            } else{
+                cout << "firstplayer folded flop" << " second player wins: " << firstPlayerChips << "\n";
+            }
+            folded = true;
+        }
+    }
+
+    // River
+    if (action != A_FOLD){
+        cout << "River: " << cardToString(board[4]) << "\n";
+        //action = playStreetLog("River", 1);
+        gameState riverState = playStreetLog("River", secondToAct, g);
+        action = riverState.lastStreetAction;
+        pot = pot + riverState.pot;
+        firstPlayerChips = firstPlayerChips + riverState.firstPlayerChips;
+        secondPlayerChips = secondPlayerChips + riverState.secondPlayerChips;
+        cout << "Last river action: " << actionStr(action) << ", " << "Pot: " << pot << " firstPlayerChipsOnPot: " << firstPlayerChips << " secondPlayerChipsOnPot: " << secondPlayerChips << "\n";
+        if (action != A_FOLD){
+            // Showdown: evaluate both players' best 5-card class from 7 cards
+            int* all1 = arena.alloc<int>(7);
+            int* all2 = arena.alloc<int>(7);
+            copy(p1, p1 + 2, all1); copy(board, board + 5, all1 + 2);
+            copy(p2, p2 + 2, all2); copy(board, board + 5, all2 + 2);
+            int idx1 = evaluate7_bestIndex(all1, table);
+            int idx2 = evaluate7_bestIndex(all2, table);
+
+            // For user-friendliness also compute the HandClass to print category
+            // We re-evaluate best HandClass (we could modify evaluate7_bestIndex to return it)
+            HandClass bestHC1, bestHC2;
+            bool hb1=false, hb2=false;
+            array<int,5> combo;
+            for(int a=0;a<7;a++) for(int b=a+1;b<7;b++) for(int c=b+1;c<7;c++)
+            for(int d=c+1;d<7;d++) for(int e=d+1;e<7;e++){
+                combo = { all1[a], all1[b], all1[c], all1[d], all1[e] };
+                HandClass hc = classify5(combo);
+                if(!hb1 || handClassBetter(hc, bestHC1)) { bestHC1 = hc; hb1=true; }
+                combo = { all2[a], all2[b], all2[c], all2[d], all2[e] };
+                HandClass hc2 = classify5(combo);
+                if(!hb2 || handClassBetter(hc2, bestHC2)) { bestHC2 = hc2; hb2=true; }
+            }
+
+            cout << "\n-- Showdown --\n";
+            cout << "Board: " << cardToString(board[0]) << ", " << cardToString(board[1]) << ", "
+                << cardToString(board[2]) << ", " << cardToString(board[3]) << ", " << cardToString(board[4]) << "\n\n";
+
+            cout << "Player 1: " << cardToString(p1[0]) << ", " << cardToString(p1[1]) << "\n";
+            cout << "  Category: " << categoryName(bestHC1.category)
+                << "  Index: " << idx1 << " (1=best, 7462=worst)\n";
+
+            cout << "Player 2: " << cardToString(p2[0]) << ", " << cardToString(p2[1]) << "\n";
+            cout << "  Category: " << categoryName(bestHC2.category)
+                << "  Index: " << idx2 << " (1=best, 7462=worst)\n";
+
+            if(idx1 < idx2) cout << "Result: Player 1 wins "  << secondPlayerChips << "(lower index = better)\n";
+            else if(idx2 < idx1) cout << "Result: Player 2 wins" << firstPlayerChips << "\n";
+            else cout << "Result: Tie (equal index)\n";
+        } else {
+        if(firstPlayerChips > secondPlayerChips){
+            cout << "secondplayer folded river" << " firstplayer wins: " << secondPlayerChips << "\n";
+        } else{
+            cout << "firstplayer folded river" << " second player wins: " << firstPlayerChips << "\n";
+        }
+    }
+    } else {
+        if (folded == false){
+            if(firstPlayerChips > secondPlayerChips){
+                cout << "secondplayer folded turn" << " firstplayer wins: " << secondPlayerChips << "\n";
+            } else{
+                cout << "firstplayer folded turn" << " second player wins: " << firstPlayerChips << "\n";
+            }
+            folded = true;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    // Build canonical table once
+    CanonTable table;
+    table.build();
+    // Sanity check: number of classes should be 7462
+    cout << "Expect 7462 distinct classes. Found: " << table.classes.size() << "\n";
+
+    // Optional modes; without arguments we print 3 hands as before
+    string mode = (argc > 1 ? argv[1] : "");
+    if(mode == "batch") {
+        int hands = (argc > 2 ? atoi(argv[2]) : 100000);
+        int batch = (argc > 3 ? atoi(argv[3]) : 256);
+        return runBatchMode(hands, max(batch, 1), table);
+    }
+    if(mode == "encode") {
+        int n = (argc > 2 ? atoi(argv[2]) : 10000000);
+        return runEncodeBench(n, table);
+    }
+    if(mode == "selfplay") {
+        int hands = (argc > 2 ? atoi(argv[2]) : 100000);
+        string prefix = (argc > 3 ? argv[3] : "selfplay");
+        return runSelfPlay(hands, prefix, table);
+    }
+    if(mode == "br") {
+        return runBestResponse(vector<string>(argv + 2, argv + argc), table);
+    }
+    if(mode == "resolve") {
+        return runResolve(vector<string>(argv + 2, argv + argc), table);
+    }
+    if(mode == "strategy") {
+        string path = (argc > 2 ? argv[2] : "strategy.pkst");
+        int bits = (argc > 3 ? atoi(argv[3]) : 8);
+        return runStrategyTable(path, bits, table);
+    }
+    if(mode == "history") {
+        return runHistoryCheck();
+    }
+    if(mode == "hhwrite") {
+        string path = (argc > 2 ? argv[2] : "hands.txt");
+        int hands = (argc > 3 ? atoi(argv[3]) : 100000);
+        int allIn = (argc > 4 ? atoi(argv[4]) : 0);
+        return runHandHistoryWrite(path, hands, allIn, table);
+    }
+    if(mode == "hhimport") {
+        return runHandHistoryImport(argc > 2 ? argv[2] : "hands.txt", table);
+    }
+    if(mode == "allinev") {
+        return runAllInEV(argc > 2 ? argv[2] : "hands.txt", table);
+    }
+    if(mode == "omaha" || mode == "omaha8") {
+        return runOmaha(vector<string>(argv + 2, argv + argc), table, mode == "omaha8");
+    }
+    if(mode == "shortdeck") {
+        return runShortDeck(argc > 2 ? atoi(argv[2]) : 200000);
+    }
+    if(mode == "lowball") {
+        return runLowball();
+    }
+    if(mode == "stud") {
+        int hands = (argc > 2 ? atoi(argv[2]) : 100000);
+        int players = (argc > 3 ? atoi(argv[3]) : 2);
+        return runStud(hands, players, table);
+    }
+    if(mode == "categories") {
+        return runCategoryOdds(vector<string>(argv + 2, argv + argc), table);
+    }
+    if(mode == "draws") {
+        return runDraws(vector<string>(argv + 2, argv + argc));
+    }
+    if(mode == "texture") {
+        return runTexture(vector<string>(argv + 2, argv + argc), table);
+    }
+    if(mode == "mcequity") {
+        return runMonteCarloEquity(vector<string>(argv + 2, argv + argc), table);
+    }
+    if(mode == "vecenv") {
+        int tables = (argc > 2 ? max(1, atoi(argv[2])) : 1024);
+        long long steps = (argc > 3 ? atoll(argv[3]) : 5000);
+        return runVecEnv(tables, steps, table);
+    }
+    if(mode == "makeunmake") {
+        return runMakeUnmake(argc > 2 ? max(1, atoi(argv[2])) : 200, table);
+    }
+    if(mode == "mcts") {
+        int hands = (argc > 2 ? max(1, atoi(argv[2])) : 1000);
+        int threads = (argc > 3 ? max(1, atoi(argv[3])) : 1);
+        return runMcts(hands, threads, table);
+    }
+    if(mode == "alloccheck") {
+        return runAllocCheck(argc > 2 ? max(1, atoi(argv[2])) : 10000, table);
+    }
+    if(mode == "replay") {
+        if(argc < 4) { cerr << "Usage: replay <run seed> <hand number>\n"; return 1; }
+        playHandLog(atoi(argv[3]), strtoull(argv[2], nullptr, 10), table);
+        return 0;
+    }
+
+    // Simulate 3 hands (or "play [hands] [seed]")
+    int numHands = 3;
+    uint64_t runSeed = ((uint64_t)random_device{}() << 32) | random_device{}();
+    if(mode == "play") {
+        if(argc > 2) numHands = atoi(argv[2]);
+        if(argc > 3) runSeed = strtoull(argv[3], nullptr, 10);
     }
+    cout << "Run seed: " << runSeed << "\n";
+    for(int hnum=1; hnum<=numHands; ++hnum) playHandLog(hnum, runSeed, table);
 
     cout << "\nSimulation complete.\n";
     return 0;